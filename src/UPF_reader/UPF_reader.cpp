@@ -1,8 +1,77 @@
 #include "UPF_reader.hpp"
 #include <iostream>
 #include <fstream>
-#include <sstream>
 #include <filesystem>
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#ifndef __cpp_lib_to_chars
+#include <locale.h>
+#endif
+#include "../parallel/thread_pool.hpp"
+#include "../density/atomic_density.hpp"
+
+namespace {
+
+// Call emit for up to `max` whitespace separated numbers of text, returns
+// how many were read. std::from_chars ignores the locale, a host that
+// calls setlocale() (e.g. wxWidgets) still reads "1.5" as 1.5.
+template <typename Emit>
+size_t decode_values(const char* text, size_t max, Emit emit) {
+    const char* end = text + std::strlen(text);
+#ifndef __cpp_lib_to_chars
+    static const locale_t c_locale = newlocale(LC_ALL_MASK, "C", nullptr);
+#endif
+    size_t count = 0;
+    while (count < max) {
+        while (text < end && (*text == ' ' || *text == '\n' || *text == '\t' || *text == '\r')) {
+            ++text;
+        }
+        if (text < end && *text == '+') {
+            ++text;
+        }
+        double value = 0.0;
+#ifdef __cpp_lib_to_chars
+        auto result = std::from_chars(text, end, value);
+        if (result.ec != std::errc()) {
+            break;
+        }
+        text = result.ptr;
+#else
+        char* next = nullptr;
+        value = strtod_l(text, &next, c_locale);
+        if (next == text) {
+            break;
+        }
+        text = next;
+#endif
+        emit(count++, value);
+    }
+    return count;
+}
+
+// Convert up to `max` numbers from text into out, returns how many were read
+size_t decode_values(const char* text, double* out, size_t max) {
+    return decode_values(text, max, [out](size_t i, double value) { out[i] = value; });
+}
+
+// Decode all numbers of a node's text, the size attribute (if any) is
+// only used to reserve memory
+std::vector<double> decode_values(const pugi::xml_node& node, const char* size_attribute) {
+    std::vector<double> values;
+    if (size_attribute) {
+        values.reserve(node.attribute(size_attribute).as_ullong());
+    }
+    decode_values(node.text().get(), std::numeric_limits<size_t>::max(),
+                  [&values](size_t, double value) { values.push_back(value); });
+    return values;
+}
+
+} // namespace
 
 UPFReader::UPFReader(const std::string& filename)
     : filename_(filename) {
@@ -14,12 +83,38 @@ UPFReader::UPFReader(const std::string& filename)
     header_.l_max = 0;
     header_.is_ultrasoft = false;
     header_.has_so = false;
+    header_.is_paw = false;
+    header_.number_of_proj = 0;
 }
 
 bool UPFReader::parse() {
     // Reset global validity flag
     g_upf_data_valid = false;
 
+    if (!load()) {
+        return false;
+    }
+
+    // A single file is a batch of one
+    compute_hartree_potentials({&data_});
+    publish_globals();
+    return true;
+}
+
+bool UPFReader::parse_buffer(std::vector<char> buffer) {
+    // Reset global validity flag
+    g_upf_data_valid = false;
+
+    if (!load_buffer(std::move(buffer))) {
+        return false;
+    }
+
+    compute_hartree_potentials({&data_});
+    publish_globals();
+    return true;
+}
+
+bool UPFReader::load() {
     // Load and parse the XML file
     pugi::xml_parse_result result = doc_.load_file(filename_.c_str());
     if (!result) {
@@ -27,29 +122,90 @@ bool UPFReader::parse() {
         return false;
     }
 
-    // Clear D coefficients
+    return parse_document();
+}
+
+bool UPFReader::load_files(const std::vector<std::string>& filenames, std::vector<UPFData>& data) {
+    data.assign(filenames.size(), UPFData());
+    std::atomic<bool> ok{true};
+    TaskGroup group;
+    for (size_t i = 0; i < filenames.size(); ++i) {
+        group.run([&, i] {
+            UPFReader reader(filenames[i]);
+            if (!reader.load()) {
+                std::cerr << "Error: Could not parse '" << filenames[i] << "'\n";
+                ok = false;
+                return;
+            }
+            data[i] = std::move(reader.data_);
+        });
+    }
+    group.wait();
+
+    std::vector<UPFData*> batch;
+    for (auto& entry : data) {
+        if (entry.valid) {
+            batch.push_back(&entry);
+        }
+    }
+    compute_hartree_potentials(batch);
+
+    return ok;
+}
+
+bool UPFReader::load_buffer(std::vector<char> buffer) {
+    // Parse the XML in place, the reader owns the buffer from now on
+    buffer_ = std::move(buffer);
+    pugi::xml_parse_result result = doc_.load_buffer_inplace(buffer_.data(), buffer_.size());
+    if (!result) {
+        std::cerr << "Failed to parse UPF file: " << result.description() << "\n";
+        return false;
+    }
+
+    return parse_document();
+}
+
+bool UPFReader::parse_document() {
+    // Clear data left over from a previous parse
     d_coefficients_.clear();
+    orbitals_.clear();
+    decode_jobs_.clear();
+    mesh_r_.clear();
+    mesh_rab_.clear();
+    mesh_points_ = 0;
+    data_ = UPFData();
+
+    // Find all sections in one pass
+    if (!sections_.build(doc_)) {
+        return false;
+    }
 
-    // Parse different sections
-    if (!parse_header() || !parse_mesh() || !parse_local() || !parse_nonlocal() || 
-        !parse_wavefunctions() || !parse_dij()) {
+    // Queue their numeric contents, sections with a destination in the
+    // schema need no code of their own
+    if (!parse_header() || !parse_mesh() || !parse_nonlocal() || !parse_wavefunctions() ||
+        !parse_augmentation() || !parse_paw()) {
         return false;
     }
+    schedule_schema_sections();
 
-    // Update global variables
-    g_upf_header = {
+    // Decode everything at once, then the steps that combine sections
+    if (!decode_sections() || !build_mesh() || !build_orbitals() || !build_dij() || !build_augmentation()) {
+        return false;
+    }
+
+    data_.header = {
         header_.element,
         header_.pseudo_type,
         header_.z_valence,
         header_.mesh_size,
         header_.l_max,
         header_.is_ultrasoft,
-        header_.has_so
+        header_.has_so,
+        header_.is_paw,
+        header_.number_of_proj
     };
 
-    g_r_mesh = r_mesh_;
-    
-    // Convert and store orbitals in global storage
+    // Convert and store orbitals
     for (const auto& [type, orbs] : orbitals_) {
         std::vector<GlobalOrbitalData> global_orbs;
         for (const auto& orb : orbs) {
@@ -59,25 +215,24 @@ bool UPFReader::parse() {
             global_orb.l = static_cast<int>(orb.l);
             global_orbs.push_back(global_orb);
         }
-        g_orbitals[static_cast<int>(type)] = global_orbs;
+        data_.orbitals[static_cast<int>(type)] = global_orbs;
     }
 
     // Calculate and store potentials
     calculate_potentials();
 
     // Calculate total potentials for each orbital momentum
-    g_total_potentials.clear();
-    for (const auto& [l, nonlocal_pot] : g_nonlocal_potentials) {
-        const auto& projector_values = g_projectors[l];
-        std::vector<double> total_potential(g_r_mesh.size(), 0.0);
+    for (const auto& [l, nonlocal_pot] : data_.nonlocal_potentials) {
+        const auto& projector_values = data_.projectors[l];
+        std::vector<double> total_potential(data_.mesh->size(), 0.0);
         
         // Get number of projectors for this l
         size_t n_proj = d_coefficients_[l].size();
         size_t points_per_proj = projector_values.size() / n_proj;
         
         // V_l^total(r) = V_local(r) + Σ_{i,j} D_{i,j} P_{l,i}(r) P_{l,j}(r)
-        for (size_t r = 0; r < g_r_mesh.size(); ++r) {
-            total_potential[r] = g_local_potential[r];
+        for (size_t r = 0; r < data_.mesh->size(); ++r) {
+            total_potential[r] = data_.local_potential[r];
             
             // Add the nonlocal contribution using D coefficients
             for (size_t i = 0; i < n_proj; ++i) {
@@ -89,22 +244,37 @@ bool UPFReader::parse() {
             }
         }
         
-        g_total_potentials[l] = std::move(total_potential);
+        data_.total_potentials[l] = std::move(total_potential);
     }
 
-    // Set global validity flag
-    g_upf_data_valid = true;
+    data_.valid = true;
 
     return true;
 }
 
+void UPFReader::publish_globals() const {
+    // Update global variables
+    g_upf_header = data_.header;
+    g_mesh = data_.mesh;
+    g_orbitals = data_.orbitals;
+    g_local_potential = data_.local_potential;
+    g_nonlocal_potentials = data_.nonlocal_potentials;
+    g_projectors = data_.projectors;
+    g_total_potentials = data_.total_potentials;
+    g_betas = data_.betas;
+    g_dij = data_.dij;
+    g_chis = data_.chis;
+    g_density = data_.density;
+    g_augmentation = data_.augmentation;
+    g_paw = data_.paw;
+
+    // Set global validity flag
+    g_upf_data_valid = true;
+}
+
 bool UPFReader::parse_header() {
     // Get the PP_HEADER node
-    pugi::xml_node header = doc_.child("UPF").child("PP_HEADER");
-    if (!header) {
-        std::cerr << "Error: PP_HEADER section not found\n";
-        return false;
-    }
+    pugi::xml_node header = sections_.node(UPFSection::HEADER);
 
     // Extract header information
     header_.element = header.attribute("element").as_string();
@@ -114,6 +284,8 @@ bool UPFReader::parse_header() {
     header_.l_max = header.attribute("l_max").as_int();
     header_.is_ultrasoft = std::string(header.attribute("is_ultrasoft").as_string()) == "T";
     header_.has_so = std::string(header.attribute("has_so").as_string()) == "T";
+    header_.is_paw = std::string(header.attribute("is_paw").as_string()) == "T";
+    header_.number_of_proj = header.attribute("number_of_proj").as_int();
 
     return true;
 }
@@ -125,9 +297,32 @@ void UPFReader::display_info() const {
     std::cout << "Pseudo Type: " << header_.pseudo_type << "\n";
     std::cout << "Z Valence: " << header_.z_valence << "\n";
     std::cout << "Mesh Size: " << header_.mesh_size << "\n";
+    std::cout << "Distinct Meshes Loaded: " << meshes_loaded_ << "\n";
+    if (data_.mesh) {
+        const MeshParameters& p = data_.mesh->parameters();
+        std::cout << "Mesh Type: ";
+        switch (p.type) {
+            case MeshType::LINEAR:
+                std::cout << "linear (r0=" << p.r0 << ", dx=" << p.dx << ")\n";
+                break;
+            case MeshType::LOGARITHMIC: {
+                // xmin is relative to zmesh, r_i = exp(xmin + i*dx)/zmesh
+                double zmesh = sections_.node(UPFSection::MESH).attribute("zmesh").as_double(1.0);
+                std::cout << "logarithmic (xmin=" << std::log(p.r0 * zmesh) << ", dx=" << p.dx
+                          << ", zmesh=" << zmesh << ")\n";
+                break;
+            }
+            case MeshType::SHIFTED_LOG:
+                std::cout << "shifted logarithmic (a=" << p.a << ", dx=" << p.dx << ")\n";
+                break;
+            default:
+                std::cout << "tabulated\n";
+        }
+    }
     std::cout << "L Max: " << header_.l_max << "\n";
     std::cout << "Is Ultrasoft: " << (header_.is_ultrasoft ? "Yes" : "No") << "\n";
     std::cout << "Has Spin-Orbit: " << (header_.has_so ? "Yes" : "No") << "\n";
+    std::cout << "Is PAW: " << (header_.is_paw ? "Yes" : "No") << "\n";
     
     // Display orbital information
     for (const auto& [type, orbs] : orbitals_) {
@@ -137,81 +332,169 @@ void UPFReader::display_info() const {
                       << orb.values.size() << " points\n";
         }
     }
+
+    // Display charge density information
+    if (!data_.density.rho_atom.empty()) {
+        std::cout << "\nAtomic Charge: " << data_.density.valence_charge << "\n";
+    }
+    if (!data_.density.nlcc.empty()) {
+        std::cout << "Core Charge (NLCC): " << data_.density.core_charge << "\n";
+    }
+
+    // Display augmentation information
+    if (data_.augmentation.present) {
+        std::cout << "\nAugmentation: " << data_.augmentation.blocks.size() << " "
+                  << (data_.augmentation.q_with_l ? "Q_ij^L" : "Q_ij") << " functions, "
+                  << data_.augmentation.values.size() << " values\n";
+    }
 }
 
-bool UPFReader::parse_mesh() {
-    pugi::xml_node mesh = doc_.child("UPF").child("PP_MESH").child("PP_R");
-    if (!mesh) {
-        std::cerr << "Error: PP_MESH/PP_R section not found\n";
-        return false;
+void UPFReader::schedule_decode(UPFSection section, const pugi::xml_node& node, std::vector<double>& values) {
+    if (node) {
+        decode_jobs_.push_back({node, section_spec(section).size_attribute, &values, nullptr, 0});
     }
+}
 
-    std::string mesh_str = mesh.text().get();
-    std::istringstream iss(mesh_str);
-    double value;
-    while (iss >> value) {
-        r_mesh_.push_back(value);
+void UPFReader::schedule_decode(const pugi::xml_node& node, double* out, size_t count) {
+    decode_jobs_.push_back({node, nullptr, nullptr, out, count});
+}
+
+void UPFReader::schedule_schema_sections() {
+    for (const SectionSpec& spec : UPF_SECTIONS) {
+        if (spec.destination) {
+            schedule_decode(spec.section, sections_.node(spec.section), *spec.destination(data_));
+        }
+    }
+}
+
+bool UPFReader::decode_sections() {
+    // One task per section, large sections (augmentation, PAW) are
+    // balanced by work stealing
+    std::atomic<const DecodeJob*> failed{nullptr};
+    TaskGroup group;
+    for (const DecodeJob& job : decode_jobs_) {
+        group.run([&job, &failed]() {
+            if (job.values) {
+                *job.values = decode_values(job.node, job.size_attribute);
+            } else if (decode_values(job.node.text().get(), job.out, job.count) != job.count) {
+                const DecodeJob* expected = nullptr;
+                failed.compare_exchange_strong(expected, &job);
+            }
+        });
     }
+    group.wait();
 
+    if (failed) {
+        std::cerr << "Error: Not enough values in " << failed.load()->node.name() << "\n";
+        return false;
+    }
+
+    decode_jobs_.clear();
     return true;
 }
 
-bool UPFReader::parse_local() {
-    pugi::xml_node local = doc_.child("UPF").child("PP_LOCAL");
-    if (!local) {
-        return true; // Local potential is optional
+bool UPFReader::parse_mesh() {
+    pugi::xml_node mesh = sections_.node(UPFSection::R);
+    const char* size_attribute = section_spec(UPFSection::R).size_attribute;
+
+    // Later sections are sized by the mesh, decode it right away if
+    // neither the header nor PP_R tell its size
+    mesh_points_ = header_.mesh_size > 0 ? header_.mesh_size : mesh.attribute(size_attribute).as_ullong();
+    if (mesh_points_ == 0) {
+        mesh_r_ = decode_values(mesh, size_attribute);
+        mesh_points_ = mesh_r_.size();
+    } else {
+        schedule_decode(UPFSection::R, mesh, mesh_r_);
     }
+    schedule_decode(UPFSection::RAB, sections_.node(UPFSection::RAB), mesh_rab_);
 
-    std::string local_str = local.text().get();
-    std::istringstream iss(local_str);
-    std::vector<double> values;
-    double value;
-    while (iss >> value) {
-        values.push_back(value);
+    return true;
+}
+
+bool UPFReader::build_mesh() {
+    // Share one instance between all files with the same mesh
+    data_.mesh = MeshRegistry::instance().intern(std::move(mesh_r_), std::move(mesh_rab_));
+    meshes_loaded_ = MeshRegistry::instance().size();
+    mesh_r_.clear();
+    mesh_rab_.clear();
+
+    return true;
+}
+
+bool UPFReader::parse_nonlocal() {
+    // All beta functions with their angular momentum
+    std::vector<std::pair<int, pugi::xml_node>> nodes;
+    for (pugi::xml_node child : sections_.nodes(UPFSection::BETA)) {
+        BetaFunction beta;
+        beta.index = child.attribute("index").as_int(std::atoi(child.name() + 8));
+        beta.l = child.attribute("angular_momentum").as_int();
+        if (beta.l < 0) {
+            std::cerr << "Error: Negative angular_momentum in " << child.name() << "\n";
+            return false;
+        }
+        beta.cutoff_radius_index = child.attribute("cutoff_radius_index").as_int();
+        beta.cutoff_radius = child.attribute("cutoff_radius").as_double();
+        data_.betas.push_back(std::move(beta));
+        nodes.emplace_back(data_.betas.back().index, child);
+    }
+    std::stable_sort(data_.betas.begin(), data_.betas.end(),
+                     [](const BetaFunction& a, const BetaFunction& b) { return a.index < b.index; });
+    std::stable_sort(nodes.begin(), nodes.end(),
+                     [](const auto& a, const auto& b) { return a.first < b.first; });
+
+    // Queue only once all are added, the vector must not move anymore
+    for (size_t i = 0; i < nodes.size(); ++i) {
+        schedule_decode(UPFSection::BETA, nodes[i].second, data_.betas[i].values);
     }
 
-    if (!values.empty()) {
+    return true;
+}
+
+bool UPFReader::build_orbitals() {
+    if (!data_.local_potential.empty()) {
         OrbitalData data;
-        data.values = values;
+        data.values = data_.local_potential;
         data.projector = {};
         data.l = QuantumNumber::S;
         orbitals_[OrbitalType::LOCAL].push_back(data);
     }
 
-    return true;
-}
+    // Legacy wavefunctions without values are dropped
+    auto wavefunctions = orbitals_.find(OrbitalType::WAVEFUNCTION);
+    if (wavefunctions != orbitals_.end()) {
+        auto& orbs = wavefunctions->second;
+        orbs.erase(std::remove_if(orbs.begin(), orbs.end(),
+                                  [](const OrbitalData& orb) { return orb.values.empty(); }),
+                   orbs.end());
+        if (orbs.empty()) {
+            orbitals_.erase(wavefunctions);
+        }
+    }
 
-bool UPFReader::parse_nonlocal() {
-    pugi::xml_node nonlocal = doc_.child("UPF").child("PP_NONLOCAL");
-    if (!nonlocal) {
-        return true; // Nonlocal potential is optional
+    if (!sections_.node(UPFSection::NONLOCAL)) {
+        return true;
+    }
+
+    // Legacy explicit projectors PP_BETA_n by n
+    std::map<int, pugi::xml_node> projectors;
+    for (pugi::xml_node proj : sections_.nodes(UPFSection::BETA_PROJECTOR)) {
+        projectors.emplace(std::atoi(proj.name() + 8), proj);
     }
 
     for (int l = 0; l <= header_.l_max; ++l) {
-        std::string beta_name = "PP_BETA." + std::to_string(l + 1);
-        pugi::xml_node beta = nonlocal.child(beta_name.c_str());
-        if (!beta) continue;
+        auto beta = std::find_if(data_.betas.begin(), data_.betas.end(),
+                                 [l](const BetaFunction& b) { return b.index == l + 1; });
+        if (beta == data_.betas.end()) continue;
 
         // Get nonlocal potential
-        std::string beta_str = beta.text().get();
-        std::istringstream iss(beta_str);
-        std::vector<double> values;
-        double value;
-        while (iss >> value) {
-            values.push_back(value);
-        }
+        const std::vector<double>& values = beta->values;
 
         // Get projector function
-        std::string proj_name = "PP_BETA_" + std::to_string(l + 1);
-        pugi::xml_node proj = nonlocal.child(proj_name.c_str());
+        auto proj = projectors.find(l + 1);
         std::vector<double> projector;
         
-        if (proj) {
-            std::string proj_str = proj.text().get();
-            std::istringstream proj_iss(proj_str);
-            while (proj_iss >> value) {
-                projector.push_back(value);
-            }
+        if (proj != projectors.end()) {
+            projector = decode_values(proj->second, section_spec(UPFSection::BETA_PROJECTOR).size_attribute);
         } else {
             // If no explicit projector, use the beta function as projector
             projector = values;
@@ -230,31 +513,49 @@ bool UPFReader::parse_nonlocal() {
 }
 
 bool UPFReader::parse_wavefunctions() {
-    pugi::xml_node chi = doc_.child("UPF").child("PP_CHI");
-    if (!chi) {
+    // All pseudo wavefunctions with their angular momentum
+    std::vector<std::pair<int, pugi::xml_node>> nodes;
+    for (pugi::xml_node child : sections_.nodes(UPFSection::CHI)) {
+        ChiFunction wfc;
+        wfc.index = child.attribute("index").as_int(std::atoi(child.name() + 7));
+        wfc.l = child.attribute("l").as_int();
+        wfc.label = child.attribute("label").as_string();
+        wfc.occupation = child.attribute("occupation").as_double();
+        data_.chis.push_back(std::move(wfc));
+        nodes.emplace_back(data_.chis.back().index, child);
+    }
+    std::stable_sort(data_.chis.begin(), data_.chis.end(),
+                     [](const ChiFunction& a, const ChiFunction& b) { return a.index < b.index; });
+    std::stable_sort(nodes.begin(), nodes.end(),
+                     [](const auto& a, const auto& b) { return a.first < b.first; });
+    for (size_t i = 0; i < nodes.size(); ++i) {
+        schedule_decode(UPFSection::CHI, nodes[i].second, data_.chis[i].values);
+    }
+
+    if (!sections_.node(UPFSection::LEGACY_CHI)) {
         return true; // Wavefunctions are optional
     }
 
+    // Legacy wavefunctions PP_CHI.n by n
+    std::map<int, pugi::xml_node> chis;
+    for (pugi::xml_node wfc : sections_.nodes(UPFSection::LEGACY_CHI_N)) {
+        chis.emplace(std::atoi(wfc.name() + 7), wfc);
+    }
+
+    std::vector<pugi::xml_node> wfc_nodes;
     for (int l = 0; l <= header_.l_max; ++l) {
-        std::string chi_name = "PP_CHI." + std::to_string(l + 1);
-        pugi::xml_node wfc = chi.child(chi_name.c_str());
-        if (!wfc) continue;
-
-        std::string wfc_str = wfc.text().get();
-        std::istringstream iss(wfc_str);
-        std::vector<double> values;
-        double value;
-        while (iss >> value) {
-            values.push_back(value);
-        }
+        auto chi = chis.find(l + 1);
+        if (chi == chis.end()) continue;
+        pugi::xml_node wfc = chi->second;
 
-        if (!values.empty()) {
-            OrbitalData data;
-            data.values = values;
-            data.projector = {};
-            data.l = static_cast<QuantumNumber>(l);
-            orbitals_[OrbitalType::WAVEFUNCTION].push_back(data);
-        }
+        OrbitalData data;
+        data.projector = {};
+        data.l = static_cast<QuantumNumber>(l);
+        orbitals_[OrbitalType::WAVEFUNCTION].push_back(data);
+        wfc_nodes.push_back(wfc);
+    }
+    for (size_t i = 0; i < wfc_nodes.size(); ++i) {
+        schedule_decode(UPFSection::LEGACY_CHI_N, wfc_nodes[i], orbitals_[OrbitalType::WAVEFUNCTION][i].values);
     }
 
     return true;
@@ -310,15 +611,8 @@ std::vector<double> UPFReader::get_projector(QuantumNumber l) const {
     return std::vector<double>();
 }
 
-bool UPFReader::parse_dij() {
-    pugi::xml_node dij = doc_.child("UPF").child("PP_NONLOCAL").child("PP_DIJ");
-    if (!dij) {
-        std::cerr << "Error: PP_DIJ section not found\n";
-        return false;
-    }
-
-    std::string dij_str = dij.text().get();
-    std::istringstream iss(dij_str);
+bool UPFReader::build_dij() {
+    size_t next = 0;
     
     // Initialize D coefficients matrix for each l
     for (int l = 0; l <= header_.l_max; ++l) {
@@ -336,12 +630,11 @@ bool UPFReader::parse_dij() {
         // Read D coefficients
         for (size_t i = 0; i < n_proj; ++i) {
             for (size_t j = 0; j < n_proj; ++j) {
-                double value;
-                if (!(iss >> value)) {
+                if (next >= data_.dij.size()) {
                     std::cerr << "Error: Not enough D coefficients in PP_DIJ\n";
                     return false;
                 }
-                d_matrix[i][j] = value;
+                d_matrix[i][j] = data_.dij[next++];
             }
         }
         
@@ -353,12 +646,12 @@ bool UPFReader::parse_dij() {
 
 void UPFReader::calculate_potentials() {
     // Store local potential
-    g_local_potential = get_local_potential();
+    data_.local_potential = get_local_potential();
 
     // Store nonlocal potentials and projectors for each quantum number
     for (int l = 0; l <= header_.l_max; ++l) {
         auto qn = static_cast<QuantumNumber>(l);
-        g_nonlocal_potentials[static_cast<int>(qn)] = get_nonlocal_potential(qn);
+        data_.nonlocal_potentials[static_cast<int>(qn)] = get_nonlocal_potential(qn);
         
         // Get all projectors for this l and combine them into a single vector
         std::vector<double> combined_projectors;
@@ -369,6 +662,141 @@ void UPFReader::calculate_potentials() {
                                         orbital.projector.end());
             }
         }
-        g_projectors[static_cast<int>(qn)] = std::move(combined_projectors);
+        data_.projectors[static_cast<int>(qn)] = std::move(combined_projectors);
     }
 }
+
+bool UPFReader::parse_augmentation() {
+    data_.augmentation = AugmentationData();
+
+    pugi::xml_node aug = sections_.node(UPFSection::AUGMENTATION);
+    if (!aug) {
+        if (header_.is_ultrasoft || header_.is_paw) {
+            std::cerr << "Error: PP_AUGMENTATION section not found\n";
+            return false;
+        }
+        return true; // Only ultrasoft and PAW potentials are augmented
+    }
+
+    data_.augmentation.present = true;
+    data_.augmentation.q_with_l = std::string(aug.attribute("q_with_l").as_string()) == "T";
+    data_.augmentation.l_max_aug = aug.attribute("l_max_aug").as_int(-1);
+    data_.augmentation.cutoff_r_index = aug.attribute("cutoff_r_index").as_int();
+
+    // Number of beta functions, fall back to counting them
+    int nbeta = header_.number_of_proj;
+    if (nbeta <= 0) {
+        nbeta = static_cast<int>(sections_.nodes(UPFSection::BETA).size());
+    }
+    data_.augmentation.nbeta = nbeta;
+
+    // Integrals of the augmentation functions
+    // Augmentation functions vanish beyond the cutoff, only store up to it
+    size_t mesh = mesh_points_;
+    size_t n_stored = mesh;
+    int cutoff = std::max(data_.augmentation.cutoff_r_index, aug.attribute("iraug").as_int());
+    if (cutoff > 0 && static_cast<size_t>(cutoff) < mesh) {
+        n_stored = cutoff;
+    }
+
+    // First pass: find all blocks and assign them their place in the packed array
+    UPFSection section = data_.augmentation.q_with_l ? UPFSection::QIJL : UPFSection::QIJ;
+    const char* size_attribute = section_spec(section).size_attribute;
+    std::vector<pugi::xml_node> nodes;
+    size_t total = 0;
+    int l_max_found = -1;
+    for (pugi::xml_node child : sections_.nodes(section)) {
+        AugmentationBlock block;
+        block.i = child.attribute("first_index").as_int() - 1;
+        block.j = child.attribute("second_index").as_int() - 1;
+        block.l = data_.augmentation.q_with_l ? child.attribute("angular_momentum").as_int() : -1;
+        if (data_.augmentation.q_with_l && block.l < 0) {
+            std::cerr << "Error: Negative angular_momentum in " << child.name() << "\n";
+            return false;
+        }
+        if (block.i > block.j) {
+            std::swap(block.i, block.j);
+        }
+        if (block.i < 0 || block.j >= nbeta) {
+            std::cerr << "Error: Invalid indices in " << child.name() << "\n";
+            return false;
+        }
+
+        size_t size = child.attribute(size_attribute).as_ullong(mesh);
+        block.size = std::min(size, n_stored);
+        block.offset = total;
+        total += block.size;
+        l_max_found = std::max(l_max_found, block.l);
+
+        data_.augmentation.blocks.push_back(block);
+        nodes.push_back(child);
+    }
+    data_.augmentation.values.resize(total);
+
+    if (data_.augmentation.l_max_aug < l_max_found) {
+        data_.augmentation.l_max_aug = l_max_found;
+    }
+
+    // Lookup table (pair, L) -> block
+    size_t n_pairs = static_cast<size_t>(nbeta) * (nbeta + 1) / 2;
+    size_t n_slots = data_.augmentation.l_max_aug + 2;
+    data_.augmentation.block_index.assign(n_pairs * n_slots, -1);
+    for (size_t b = 0; b < data_.augmentation.blocks.size(); ++b) {
+        const auto& block = data_.augmentation.blocks[b];
+        size_t slot = AugmentationData::pair_index(block.i, block.j) * n_slots + (block.l + 1);
+        data_.augmentation.block_index[slot] = static_cast<int>(b);
+    }
+
+    // Second pass: every block is decoded into its place in the packed array
+    for (size_t b = 0; b < data_.augmentation.blocks.size(); ++b) {
+        const auto& block = data_.augmentation.blocks[b];
+        schedule_decode(nodes[b], data_.augmentation.values.data() + block.offset, block.size);
+    }
+
+    return true;
+}
+
+bool UPFReader::build_augmentation() {
+    if (!data_.augmentation.present || data_.augmentation.q.empty()) {
+        return true;
+    }
+
+    size_t nbeta = data_.augmentation.nbeta;
+    if (data_.augmentation.q.size() != nbeta * nbeta) {
+        std::cerr << "Error: PP_Q has " << data_.augmentation.q.size()
+                  << " values, expected " << nbeta * nbeta << "\n";
+        return false;
+    }
+
+    return true;
+}
+
+bool UPFReader::parse_paw() {
+    data_.paw = PAWData();
+
+    pugi::xml_node paw = sections_.node(UPFSection::PAW);
+    if (!paw) {
+        if (header_.is_paw) {
+            std::cerr << "Error: PP_PAW section not found\n";
+            return false;
+        }
+        return true; // Only present in PAW potentials
+    }
+
+    data_.paw.present = true;
+    data_.paw.core_energy = paw.attribute("core_energy").as_double();
+
+    // All-electron and pseudo partial waves
+    const auto& ae_nodes = sections_.nodes(UPFSection::AEWFC);
+    const auto& ps_nodes = sections_.nodes(UPFSection::PAW_PSWFC);
+    data_.paw.ae_wfc.resize(ae_nodes.size());
+    data_.paw.ps_wfc.resize(ps_nodes.size());
+    for (size_t i = 0; i < ae_nodes.size(); ++i) {
+        schedule_decode(UPFSection::AEWFC, ae_nodes[i], data_.paw.ae_wfc[i]);
+    }
+    for (size_t i = 0; i < ps_nodes.size(); ++i) {
+        schedule_decode(UPFSection::PAW_PSWFC, ps_nodes[i], data_.paw.ps_wfc[i]);
+    }
+
+    return true;
+}
@@ -7,12 +7,37 @@
 #include <filesystem>
 #include <pugixml.hpp>
 #include "../globals/globals.hpp"
+#include "../mesh/radial_mesh.hpp"
+#include "upf_schema.hpp"
 
 class UPFReader {
 public:
     explicit UPFReader(const std::string& filename);
     
+    // Parse the file and publish the result to the global data
     bool parse();
+
+    // Parse from file contents that were already read into memory
+    // (the buffer is kept alive by the reader and parsed in place)
+    bool parse_buffer(std::vector<char> buffer);
+
+    // Same as parse()/parse_buffer() but without touching the global data,
+    // the result is only available through data(). Several readers can
+    // load different files concurrently.
+    bool load();
+    bool load_buffer(std::vector<char> buffer);
+
+    // Load several files in parallel and solve the Hartree potentials of
+    // all their densities in one batch. data[i] is invalid if file i
+    // failed, false if any did.
+    static bool load_files(const std::vector<std::string>& filenames, std::vector<UPFData>& data);
+
+    // Parsed data of this file, valid after a successful parse or load.
+    // load() leaves the Hartree potentials to compute_hartree_potentials(),
+    // callers batch them across files.
+    const UPFData& data() const { return data_; }
+    UPFData& data() { return data_; }
+
     void display_info() const;
 
     // Orbital types
@@ -33,14 +58,47 @@ public:
 private:
     std::string filename_;
     pugi::xml_document doc_;
+    std::vector<char> buffer_;
     
-    // Helper functions for parsing specific sections
+    // Parse all sections of the loaded document into data_
+    bool parse_document();
+
+    // Copy data_ to the global variables
+    void publish_globals() const;
+
+    // Helper functions for parsing specific sections. They only read the
+    // attributes and queue the numeric contents with schedule_decode(),
+    // the values are filled in by decode_sections(). Sections with a
+    // destination in UPF_SECTIONS are queued by schedule_schema_sections().
     bool parse_header();
     bool parse_mesh();
-    bool parse_local();
     bool parse_nonlocal();
     bool parse_wavefunctions();
-    bool parse_dij();
+    bool parse_augmentation();
+    bool parse_paw();
+    void schedule_schema_sections();
+
+    // Steps that need the decoded values
+    bool build_mesh();
+    bool build_orbitals();
+    bool build_dij();
+    bool build_augmentation();
+
+    // Numeric section waiting to be decoded, either all numbers of the node
+    // into `values` or exactly `count` numbers into `out`
+    struct DecodeJob {
+        pugi::xml_node node;
+        const char* size_attribute;
+        std::vector<double>* values;
+        double* out;
+        size_t count;
+    };
+
+    void schedule_decode(UPFSection section, const pugi::xml_node& node, std::vector<double>& values);
+    void schedule_decode(const pugi::xml_node& node, double* out, size_t count);
+
+    // Decode all queued sections in parallel, they are independent
+    bool decode_sections();
     
     // Helper functions
     std::string get_orbital_name(QuantumNumber l) const;
@@ -61,9 +119,12 @@ private:
         int l_max;
         bool is_ultrasoft;
         bool has_so;
+        bool is_paw;
+        int number_of_proj;
     } header_;
 
-    std::vector<double> r_mesh_;
+    // Parsed data, the mesh is interned in MeshRegistry
+    UPFData data_;
     
     struct OrbitalData {
         std::vector<double> values;
@@ -73,6 +134,13 @@ private:
     
     std::map<OrbitalType, std::vector<OrbitalData>> orbitals_;
     std::map<int, std::vector<std::vector<double>>> d_coefficients_; // D_{i,j} coefficients for each l
+
+    SectionIndex sections_;
+    std::vector<DecodeJob> decode_jobs_;
+    std::vector<double> mesh_r_;   // mesh until it is interned
+    std::vector<double> mesh_rab_;
+    size_t mesh_points_ = 0;       // known before the mesh is decoded
+    size_t meshes_loaded_ = 0;     // registry size right after this file's mesh was interned
 };
 
 #endif // UPF_READER_HPP
@@ -0,0 +1,51 @@
+#include "upf_schema.hpp"
+#include <iostream>
+#include <string>
+
+bool SectionIndex::build(const pugi::xml_document& doc) {
+    for (auto& list : nodes_) {
+        list.clear();
+    }
+
+    pugi::xml_node root = doc.child(section_spec(UPFSection::ROOT).tag.data());
+    if (root) {
+        nodes_[static_cast<size_t>(UPFSection::ROOT)].push_back(root);
+        collect(root, UPFSection::ROOT);
+    }
+
+    for (const SectionSpec& spec : UPF_SECTIONS) {
+        if (spec.required && nodes(spec.section).empty()) {
+            std::cerr << "Error: " << path(spec.section) << " section not found\n";
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void SectionIndex::collect(const pugi::xml_node& node, UPFSection section) {
+    for (pugi::xml_node child = node.first_child(); child; child = child.next_sibling()) {
+        if (child.type() != pugi::node_element) {
+            continue;
+        }
+
+        const SectionSpec* spec = find_section(section, child.name());
+        if (!spec) {
+            continue;  // unknown sections are skipped
+        }
+
+        nodes_[static_cast<size_t>(spec->section)].push_back(child);
+        if (spec->kind == SectionKind::CONTAINER) {
+            collect(child, spec->section);
+        }
+    }
+}
+
+std::string SectionIndex::path(UPFSection section) {
+    const SectionSpec& spec = section_spec(section);
+    std::string tag(spec.tag);
+    if (spec.parent == UPFSection::ROOT || spec.parent == UPFSection::COUNT) {
+        return tag;
+    }
+    return path(spec.parent) + "/" + tag;
+}
@@ -0,0 +1,239 @@
+#ifndef UPF_SCHEMA_HPP
+#define UPF_SCHEMA_HPP
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+#include <pugixml.hpp>
+#include "../globals/globals.hpp"
+
+// Sections of a UPF v2 file known to the reader, in the order of UPF_SECTIONS
+enum class UPFSection {
+    ROOT,            // <UPF>
+    HEADER,
+    MESH,
+    R,
+    RAB,
+    LOCAL,
+    NONLOCAL,
+    BETA,            // PP_BETA.n
+    BETA_PROJECTOR,  // PP_BETA_n, legacy explicit projectors
+    DIJ,
+    AUGMENTATION,
+    Q,
+    MULTIPOLES,
+    QIJ,             // PP_QIJ.i.j
+    QIJL,            // PP_QIJL.i.j.l
+    PSWFC,
+    CHI,             // PP_PSWFC/PP_CHI.n
+    LEGACY_CHI,      // PP_CHI, legacy wavefunction container
+    LEGACY_CHI_N,    // PP_CHI/PP_CHI.n
+    RHOATOM,
+    NLCC,
+    PAW,
+    OCCUPATIONS,
+    AE_NLCC,
+    AE_VLOC,
+    FULL_WFC,
+    AEWFC,           // PP_FULL_WFC/PP_AEWFC.n
+    PAW_PSWFC,       // PP_FULL_WFC/PP_PSWFC.n
+    COUNT
+};
+
+enum class SectionKind {
+    CONTAINER,   // holds other sections, the pass descends into it
+    ATTRIBUTES,  // only attributes are read
+    VALUES       // whitespace separated numbers
+};
+
+struct SectionSpec {
+    std::string_view tag;          // full tag, or the prefix of numbered tags ("PP_BETA.")
+    UPFSection section;
+    UPFSection parent;
+    SectionKind kind;
+    bool numbered;                 // PP_BETA.1, PP_BETA.2, ...
+    bool required;
+    const char* size_attribute;    // number of values, nullptr if there is none
+    std::vector<double>* (*destination)(UPFData&);  // decoded generically into, nullptr if
+                                                    // the reader handles the section itself
+};
+
+// Adding a section is one entry here (plus its UPFSection)
+constexpr SectionSpec UPF_SECTIONS[] = {
+    {"UPF", UPFSection::ROOT, UPFSection::COUNT, SectionKind::CONTAINER, false, true, nullptr, nullptr},
+    {"PP_HEADER", UPFSection::HEADER, UPFSection::ROOT, SectionKind::ATTRIBUTES, false, true, nullptr, nullptr},
+    {"PP_MESH", UPFSection::MESH, UPFSection::ROOT, SectionKind::CONTAINER, false, false, nullptr, nullptr},
+    {"PP_R", UPFSection::R, UPFSection::MESH, SectionKind::VALUES, false, true, "size", nullptr},
+    {"PP_RAB", UPFSection::RAB, UPFSection::MESH, SectionKind::VALUES, false, false, "size", nullptr},
+    {"PP_LOCAL", UPFSection::LOCAL, UPFSection::ROOT, SectionKind::VALUES, false, false, "size",
+     [](UPFData& d) { return &d.local_potential; }},
+    {"PP_NONLOCAL", UPFSection::NONLOCAL, UPFSection::ROOT, SectionKind::CONTAINER, false, false, nullptr, nullptr},
+    {"PP_BETA.", UPFSection::BETA, UPFSection::NONLOCAL, SectionKind::VALUES, true, false, "size", nullptr},
+    {"PP_BETA_", UPFSection::BETA_PROJECTOR, UPFSection::NONLOCAL, SectionKind::VALUES, true, false, "size", nullptr},
+    {"PP_DIJ", UPFSection::DIJ, UPFSection::NONLOCAL, SectionKind::VALUES, false, true, "size",
+     [](UPFData& d) { return &d.dij; }},
+    {"PP_AUGMENTATION", UPFSection::AUGMENTATION, UPFSection::NONLOCAL, SectionKind::CONTAINER, false, false, nullptr, nullptr},
+    {"PP_Q", UPFSection::Q, UPFSection::AUGMENTATION, SectionKind::VALUES, false, false, "size",
+     [](UPFData& d) { return &d.augmentation.q; }},
+    {"PP_MULTIPOLES", UPFSection::MULTIPOLES, UPFSection::AUGMENTATION, SectionKind::VALUES, false, false, "size",
+     [](UPFData& d) { return &d.augmentation.multipoles; }},
+    {"PP_QIJ.", UPFSection::QIJ, UPFSection::AUGMENTATION, SectionKind::VALUES, true, false, "size", nullptr},
+    {"PP_QIJL.", UPFSection::QIJL, UPFSection::AUGMENTATION, SectionKind::VALUES, true, false, "size", nullptr},
+    {"PP_PSWFC", UPFSection::PSWFC, UPFSection::ROOT, SectionKind::CONTAINER, false, false, nullptr, nullptr},
+    {"PP_CHI.", UPFSection::CHI, UPFSection::PSWFC, SectionKind::VALUES, true, false, "size", nullptr},
+    {"PP_CHI", UPFSection::LEGACY_CHI, UPFSection::ROOT, SectionKind::CONTAINER, false, false, nullptr, nullptr},
+    {"PP_CHI.", UPFSection::LEGACY_CHI_N, UPFSection::LEGACY_CHI, SectionKind::VALUES, true, false, "size", nullptr},
+    {"PP_RHOATOM", UPFSection::RHOATOM, UPFSection::ROOT, SectionKind::VALUES, false, false, "size",
+     [](UPFData& d) { return &d.density.rho_atom; }},
+    {"PP_NLCC", UPFSection::NLCC, UPFSection::ROOT, SectionKind::VALUES, false, false, "size",
+     [](UPFData& d) { return &d.density.nlcc; }},
+    {"PP_PAW", UPFSection::PAW, UPFSection::ROOT, SectionKind::CONTAINER, false, false, nullptr, nullptr},
+    {"PP_OCCUPATIONS", UPFSection::OCCUPATIONS, UPFSection::PAW, SectionKind::VALUES, false, false, "size",
+     [](UPFData& d) { return &d.paw.occupations; }},
+    {"PP_AE_NLCC", UPFSection::AE_NLCC, UPFSection::PAW, SectionKind::VALUES, false, false, "size",
+     [](UPFData& d) { return &d.paw.ae_nlcc; }},
+    {"PP_AE_VLOC", UPFSection::AE_VLOC, UPFSection::PAW, SectionKind::VALUES, false, false, "size",
+     [](UPFData& d) { return &d.paw.ae_vloc; }},
+    {"PP_FULL_WFC", UPFSection::FULL_WFC, UPFSection::ROOT, SectionKind::CONTAINER, false, false, nullptr, nullptr},
+    {"PP_AEWFC.", UPFSection::AEWFC, UPFSection::FULL_WFC, SectionKind::VALUES, true, false, "size", nullptr},
+    {"PP_PSWFC.", UPFSection::PAW_PSWFC, UPFSection::FULL_WFC, SectionKind::VALUES, true, false, "size", nullptr},
+};
+
+constexpr size_t N_UPF_SECTIONS = sizeof(UPF_SECTIONS) / sizeof(UPF_SECTIONS[0]);
+static_assert(N_UPF_SECTIONS == static_cast<size_t>(UPFSection::COUNT),
+              "UPF_SECTIONS needs one entry per UPFSection");
+
+constexpr bool sections_in_order() {
+    for (size_t i = 0; i < N_UPF_SECTIONS; ++i) {
+        if (static_cast<size_t>(UPF_SECTIONS[i].section) != i) {
+            return false;
+        }
+    }
+    return true;
+}
+static_assert(sections_in_order(), "UPF_SECTIONS must be in UPFSection order");
+
+// Numbered tags end in an index ("PP_BETA.3", "PP_QIJL.1.2.0"), they are
+// looked up by their prefix including the separator ("PP_BETA.")
+constexpr std::string_view tag_prefix(std::string_view name) {
+    size_t end = name.size();
+    while (end > 0 && ((name[end - 1] >= '0' && name[end - 1] <= '9') || name[end - 1] == '.')) {
+        --end;
+    }
+    if (end == name.size() || end == 0) {
+        return name;
+    }
+    if (name[end] == '.') {
+        ++end;
+    }
+    return name.substr(0, end);
+}
+
+// FNV-1a of the tag, combined with the parent section so that equal tags
+// in different places (PP_CHI.n) are different keys
+constexpr uint32_t section_key(UPFSection parent, std::string_view tag) {
+    uint32_t hash = 2166136261u;
+    hash = (hash ^ static_cast<uint32_t>(parent)) * 16777619u;
+    for (char c : tag) {
+        hash = (hash ^ static_cast<unsigned char>(c)) * 16777619u;
+    }
+    return hash;
+}
+
+// Perfect hash: slot = top bits of key * multiplier, with the first odd
+// multiplier for which all sections land in different slots
+constexpr size_t SECTION_SLOT_BITS = 7;
+constexpr size_t SECTION_SLOTS = size_t(1) << SECTION_SLOT_BITS;
+
+constexpr size_t section_slot(uint32_t multiplier, uint32_t key) {
+    return static_cast<uint32_t>(key * multiplier) >> (32 - SECTION_SLOT_BITS);
+}
+
+constexpr bool multiplier_is_perfect(uint32_t multiplier) {
+    bool used[SECTION_SLOTS] = {};
+    for (size_t i = 0; i < N_UPF_SECTIONS; ++i) {
+        size_t slot = section_slot(multiplier, section_key(UPF_SECTIONS[i].parent, UPF_SECTIONS[i].tag));
+        if (used[slot]) {
+            return false;
+        }
+        used[slot] = true;
+    }
+    return true;
+}
+
+constexpr uint32_t find_section_multiplier() {
+    uint32_t multiplier = 1;
+    while (!multiplier_is_perfect(multiplier)) {
+        multiplier += 2;
+    }
+    return multiplier;
+}
+
+constexpr uint32_t SECTION_MULTIPLIER = find_section_multiplier();
+
+constexpr std::array<int8_t, SECTION_SLOTS> build_section_slots() {
+    std::array<int8_t, SECTION_SLOTS> slots{};
+    for (auto& slot : slots) {
+        slot = -1;
+    }
+    for (size_t i = 0; i < N_UPF_SECTIONS; ++i) {
+        size_t slot = section_slot(SECTION_MULTIPLIER, section_key(UPF_SECTIONS[i].parent, UPF_SECTIONS[i].tag));
+        slots[slot] = static_cast<int8_t>(i);
+    }
+    return slots;
+}
+
+constexpr std::array<int8_t, SECTION_SLOTS> SECTION_SLOT_TABLE = build_section_slots();
+
+// Schema entry of a child tag of `parent`, nullptr for unknown tags
+constexpr const SectionSpec* find_section(UPFSection parent, std::string_view name) {
+    std::string_view tag = tag_prefix(name);
+    int index = SECTION_SLOT_TABLE[section_slot(SECTION_MULTIPLIER, section_key(parent, tag))];
+    if (index < 0) {
+        return nullptr;
+    }
+    const SectionSpec& spec = UPF_SECTIONS[index];
+    if (spec.parent != parent || spec.tag != tag || spec.numbered != (tag.size() != name.size())) {
+        return nullptr;
+    }
+    return &spec;
+}
+
+static_assert(find_section(UPFSection::NONLOCAL, "PP_BETA.12") == &UPF_SECTIONS[static_cast<size_t>(UPFSection::BETA)],
+              "numbered tags are found by prefix");
+static_assert(find_section(UPFSection::ROOT, "PP_BETA.1") == nullptr, "tags are only found below their parent");
+
+constexpr const SectionSpec& section_spec(UPFSection section) {
+    return UPF_SECTIONS[static_cast<size_t>(section)];
+}
+
+// Nodes of all known sections of a document, found in one pass over the
+// children of <UPF> and of the container sections
+class SectionIndex {
+public:
+    // False (with an error message) if a required section is missing
+    bool build(const pugi::xml_document& doc);
+
+    // First node of a section, empty if it is not present
+    pugi::xml_node node(UPFSection section) const {
+        const auto& list = nodes_[static_cast<size_t>(section)];
+        return list.empty() ? pugi::xml_node() : list.front();
+    }
+
+    // All nodes of a numbered section in document order
+    const std::vector<pugi::xml_node>& nodes(UPFSection section) const {
+        return nodes_[static_cast<size_t>(section)];
+    }
+
+    // "PP_NONLOCAL/PP_DIJ"
+    static std::string path(UPFSection section);
+
+private:
+    std::array<std::vector<pugi::xml_node>, N_UPF_SECTIONS> nodes_;
+
+    void collect(const pugi::xml_node& node, UPFSection section);
+};
+
+#endif // UPF_SCHEMA_HPP
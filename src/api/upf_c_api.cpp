@@ -0,0 +1,126 @@
+#include "upf_c_api.h"
+#include <exception>
+#include <iostream>
+#include <memory>
+#include "../UPF_reader/UPF_reader.hpp"
+
+struct upf_pseudopotential {
+    explicit upf_pseudopotential(const char* filename)
+        : reader(filename) {}
+
+    UPFReader reader;
+};
+
+namespace {
+
+const double* array_result(const std::vector<double>& values, size_t* size) {
+    if (size) {
+        *size = values.size();
+    }
+    return values.empty() ? nullptr : values.data();
+}
+
+const double* no_result(size_t* size) {
+    if (size) {
+        *size = 0;
+    }
+    return nullptr;
+}
+
+} // namespace
+
+upf_pseudopotential* upf_open(const char* filename) {
+    if (!filename) {
+        return nullptr;
+    }
+
+    // Exceptions must not cross the C boundary, whatever their type
+    try {
+        auto pp = std::make_unique<upf_pseudopotential>(filename);
+        if (!pp->reader.load()) {
+            return nullptr;
+        }
+        return pp.release();
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << "\n";
+        return nullptr;
+    } catch (...) {
+        std::cerr << "Error: Unknown exception while parsing '" << filename << "'\n";
+        return nullptr;
+    }
+}
+
+void upf_close(upf_pseudopotential* pp) {
+    delete pp;
+}
+
+const char* upf_element(const upf_pseudopotential* pp) {
+    return pp ? pp->reader.data().header.element.c_str() : nullptr;
+}
+
+double upf_z_valence(const upf_pseudopotential* pp) {
+    return pp ? pp->reader.data().header.z_valence : 0.0;
+}
+
+int upf_l_max(const upf_pseudopotential* pp) {
+    return pp ? pp->reader.data().header.l_max : -1;
+}
+
+int upf_is_ultrasoft(const upf_pseudopotential* pp) {
+    return pp && pp->reader.data().header.is_ultrasoft ? 1 : 0;
+}
+
+const double* upf_r(const upf_pseudopotential* pp, size_t* size) {
+    if (!pp || !pp->reader.data().mesh) {
+        return no_result(size);
+    }
+    return array_result(pp->reader.data().mesh->r(), size);
+}
+
+const double* upf_rab(const upf_pseudopotential* pp, size_t* size) {
+    if (!pp || !pp->reader.data().mesh) {
+        return no_result(size);
+    }
+    return array_result(pp->reader.data().mesh->rab(), size);
+}
+
+const double* upf_local_potential(const upf_pseudopotential* pp, size_t* size) {
+    if (!pp) {
+        return no_result(size);
+    }
+    return array_result(pp->reader.data().local_potential, size);
+}
+
+size_t upf_beta_count(const upf_pseudopotential* pp) {
+    return pp ? pp->reader.data().betas.size() : 0;
+}
+
+const double* upf_beta(const upf_pseudopotential* pp, size_t index, int* l, size_t* size) {
+    if (!pp || index >= pp->reader.data().betas.size()) {
+        return no_result(size);
+    }
+    const BetaFunction& beta = pp->reader.data().betas[index];
+    if (l) {
+        *l = beta.l;
+    }
+    return array_result(beta.values, size);
+}
+
+const double* upf_dij(const upf_pseudopotential* pp, size_t* size) {
+    if (!pp) {
+        return no_result(size);
+    }
+    return array_result(pp->reader.data().dij, size);
+}
+
+const double* upf_total_potential(const upf_pseudopotential* pp, int l, size_t* size) {
+    if (!pp) {
+        return no_result(size);
+    }
+    const auto& total_potentials = pp->reader.data().total_potentials;
+    auto it = total_potentials.find(l);
+    if (it == total_potentials.end()) {
+        return no_result(size);
+    }
+    return array_result(it->second, size);
+}
@@ -0,0 +1,55 @@
+#ifndef UPF_C_API_H
+#define UPF_C_API_H
+
+/*
+ * C interface of the upf_routines library.
+ *
+ * upf_open() parses a file into an opaque handle. The array accessors
+ * return pointers into the parsed data (no copies) and store the number
+ * of values in *size; they stay valid until upf_close(). Missing data is
+ * reported as NULL with *size set to 0.
+ *
+ * No function lets a C++ exception escape: upf_open() reports any failure
+ * as NULL, upf_close() and the accessors never throw.
+ */
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct upf_pseudopotential upf_pseudopotential;
+
+/* Parse a UPF file, NULL on failure (the reason is printed to stderr) */
+upf_pseudopotential* upf_open(const char* filename);
+void upf_close(upf_pseudopotential* pp);
+
+/* Header */
+const char* upf_element(const upf_pseudopotential* pp);
+double upf_z_valence(const upf_pseudopotential* pp);
+int upf_l_max(const upf_pseudopotential* pp);
+int upf_is_ultrasoft(const upf_pseudopotential* pp);
+
+/* Radial mesh (PP_R, PP_RAB) */
+const double* upf_r(const upf_pseudopotential* pp, size_t* size);
+const double* upf_rab(const upf_pseudopotential* pp, size_t* size);
+
+/* Local potential (PP_LOCAL) */
+const double* upf_local_potential(const upf_pseudopotential* pp, size_t* size);
+
+/* Beta projectors (PP_BETA.n), index runs from 0 to upf_beta_count() - 1 */
+size_t upf_beta_count(const upf_pseudopotential* pp);
+const double* upf_beta(const upf_pseudopotential* pp, size_t index, int* l, size_t* size);
+
+/* D_ij (PP_DIJ), upf_beta_count() x upf_beta_count(), row major */
+const double* upf_dij(const upf_pseudopotential* pp, size_t* size);
+
+/* Total potential V_l^total(r) for angular momentum l */
+const double* upf_total_potential(const upf_pseudopotential* pp, int l, size_t* size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* UPF_C_API_H */
@@ -0,0 +1,25 @@
+#ifndef UPF_ROUTINES_HPP
+#define UPF_ROUTINES_HPP
+
+// Public C++ API of the upf_routines library.
+//
+// Load a file without touching the global state and read the arrays in place:
+//
+//     UPFReader reader("Si.upf");
+//     if (reader.load()) {
+//         const UPFData& data = reader.data();
+//         data.mesh->r();             // PP_R
+//         data.local_potential;       // PP_LOCAL
+//         data.betas;                 // PP_BETA.n with angular momentum
+//         data.dij;                   // PP_DIJ
+//         data.total_potentials;      // V_l^total(r)
+//     }
+//
+// The returned references stay valid for the lifetime of the reader.
+
+#include "../globals/globals.hpp"
+#include "../mesh/radial_mesh.hpp"
+#include "../UPF_reader/UPF_reader.hpp"
+#include "../output/gnuplot_exporter.hpp"
+
+#endif // UPF_ROUTINES_HPP
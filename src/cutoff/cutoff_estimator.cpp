@@ -0,0 +1,452 @@
+#include "cutoff_estimator.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <set>
+#include <sstream>
+#include "../UPF_reader/UPF_reader.hpp"
+#include "../parallel/parallel.hpp"
+
+CutoffEstimator::CutoffEstimator(double tolerance, double q_limit)
+    : tolerance_(tolerance),
+      q_limit_(std::max(q_limit, DQ)) {
+}
+
+bool CutoffEstimator::run(const std::vector<std::filesystem::path>& inputs) {
+    results_.clear();
+
+    std::vector<std::filesystem::path> files;
+    for (const auto& input : inputs) {
+        if (!collect_files(input, files)) {
+            return false;
+        }
+    }
+
+    // A file reached twice (a library and one of its files, the same
+    // library given twice) is only estimated once
+    std::set<std::filesystem::path> seen;
+    std::vector<std::filesystem::path> unique_files;
+    for (const auto& file : files) {
+        std::error_code ec;
+        std::filesystem::path canonical = std::filesystem::weakly_canonical(file, ec);
+        if (seen.insert(ec ? file : canonical).second) {
+            unique_files.push_back(file);
+        }
+    }
+    files = std::move(unique_files);
+
+    // Parse all files in parallel, load() does not touch the global data
+    std::vector<UPFData> data(files.size());
+    results_.resize(files.size());
+    parallel_for(files.size(), [&](size_t i) {
+        results_[i].file = files[i];
+        UPFReader reader(files[i].string());
+        if (!reader.load()) {
+            return;
+        }
+        data[i] = reader.data();
+        results_[i].element = trimmed(data[i].header.element);
+        results_[i].augmented = data[i].header.is_ultrasoft || data[i].header.is_paw;
+        results_[i].ok = true;
+    });
+
+    // Every function of every file is one work item, large and small
+    // elements balance out
+    struct Task {
+        size_t file;
+        std::string name;
+        bool projector;
+        int l;
+        const std::vector<double>* values;
+        int cutoff_index;
+    };
+    std::vector<Task> tasks;
+    for (size_t i = 0; i < files.size(); ++i) {
+        if (!results_[i].ok) {
+            std::cerr << "Warning: Could not parse '" << files[i].string() << "'\n";
+            continue;
+        }
+        for (const auto& beta : data[i].betas) {
+            tasks.push_back({i, "PP_BETA." + std::to_string(beta.index), true, beta.l, &beta.values,
+                             beta.cutoff_radius_index});
+        }
+        for (const auto& chi : data[i].chis) {
+            std::string name = "PP_CHI." + std::to_string(chi.index);
+            if (!chi.label.empty()) {
+                name += " " + chi.label;
+            }
+            tasks.push_back({i, name, false, chi.l, &chi.values, 0});
+        }
+    }
+
+    std::vector<FunctionCutoff> cutoffs(tasks.size());
+    parallel_for(tasks.size(), [&](size_t t) {
+        const Task& task = tasks[t];
+        cutoffs[t] = estimate(task.name, task.l, *data[task.file].mesh, *task.values, task.cutoff_index);
+        cutoffs[t].projector = task.projector;
+    });
+
+    for (size_t t = 0; t < tasks.size(); ++t) {
+        results_[tasks[t].file].functions.push_back(std::move(cutoffs[t]));
+    }
+
+    // The hardest wavefunction sets the cutoff of the element. The density
+    // cutoff uses the usual dual: 4 for norm-conserving, 8 for augmented
+    for (auto& result : results_) {
+        bool has_wavefunctions = std::any_of(result.functions.begin(), result.functions.end(),
+                                             [](const FunctionCutoff& f) { return !f.projector; });
+        for (const auto& function : result.functions) {
+            if (function.projector) {
+                result.ecut_projectors = std::max(result.ecut_projectors, function.ecut);
+                result.projectors_converged = result.projectors_converged && function.converged;
+            }
+            if (function.projector && has_wavefunctions) {
+                continue;
+            }
+            if (function.ecut > result.ecutwfc) {
+                result.ecutwfc = function.ecut;
+                result.limiting = function.name;
+            }
+            result.converged = result.converged && function.converged;
+        }
+        result.ecutrho = (result.augmented ? 8.0 : 4.0) * result.ecutwfc;
+    }
+
+    std::stable_sort(results_.begin(), results_.end(), [](const ElementCutoff& a, const ElementCutoff& b) {
+        return a.ecutwfc > b.ecutwfc;
+    });
+
+    return true;
+}
+
+bool CutoffEstimator::collect_files(const std::filesystem::path& input, std::vector<std::filesystem::path>& files) {
+    std::error_code ec;
+    if (std::filesystem::is_regular_file(input, ec)) {
+        files.push_back(input);
+        return true;
+    }
+    if (!std::filesystem::is_directory(input, ec)) {
+        std::cerr << "Error: File '" << input.string() << "' not found\n";
+        return false;
+    }
+
+    // All .upf files of a library, in a stable order
+    std::vector<std::filesystem::path> found;
+    for (const auto& entry : std::filesystem::recursive_directory_iterator(input, ec)) {
+        std::string extension = entry.path().extension().string();
+        std::transform(extension.begin(), extension.end(), extension.begin(),
+                       [](unsigned char c) { return std::tolower(c); });
+        if (entry.is_regular_file() && extension == ".upf") {
+            found.push_back(entry.path());
+        }
+    }
+    std::sort(found.begin(), found.end());
+    files.insert(files.end(), found.begin(), found.end());
+
+    return true;
+}
+
+CutoffEstimator::FunctionCutoff CutoffEstimator::estimate(const std::string& name, int l, const RadialMesh& mesh,
+                                                          const std::vector<double>& values,
+                                                          int cutoff_index) const {
+    FunctionCutoff cutoff;
+    cutoff.name = name;
+    cutoff.l = l;
+
+    // Betas vanish beyond their cutoff radius, wavefunctions decay, only
+    // transform the part that is not negligible
+    size_t n_r = std::min(values.size(), mesh.size());
+    if (cutoff_index > 0) {
+        n_r = std::min(n_r, static_cast<size_t>(cutoff_index) + 1);
+    }
+    double peak = 0.0;
+    for (size_t i = 0; i < n_r; ++i) {
+        peak = std::max(peak, std::abs(values[i]));
+    }
+    while (n_r > 0 && std::abs(values[n_r - 1]) <= 1e-12 * peak) {
+        --n_r;
+    }
+
+    double q_max = std::min(Q_START, q_limit_);
+    if (n_r == 0) {
+        cutoff.tail.assign(static_cast<size_t>(std::lround(q_max / DQ)) + 1, 0.0);
+        return cutoff;
+    }
+
+    // The weight beyond q_max is unknown, a cutoff in the last tenth of the
+    // range means the function has not decayed yet. Double the range until
+    // it has or the limit is reached, then the estimate is a lower bound.
+    for (;;) {
+        size_t n_q = static_cast<size_t>(std::lround(q_max / DQ)) + 1;
+        cutoff.tail.assign(n_q, 0.0);
+        std::vector<double> transform = bessel_transform(mesh, values, n_r, l, DQ, n_q);
+
+        // Cumulative spectral weight (trapezoid), then the relative tail
+        std::vector<double> cumulative(n_q, 0.0);
+        for (size_t k = 1; k < n_q; ++k) {
+            double q0 = (k - 1) * DQ;
+            double q1 = k * DQ;
+            double p0 = q0 * q0 * transform[k - 1] * transform[k - 1];
+            double p1 = q1 * q1 * transform[k] * transform[k];
+            cumulative[k] = cumulative[k - 1] + 0.5 * DQ * (p0 + p1);
+        }
+        double total = cumulative[n_q - 1];
+        if (total <= 0.0) {
+            return cutoff;
+        }
+        for (size_t k = 0; k < n_q; ++k) {
+            cutoff.tail[k] = std::max(0.0, (total - cumulative[k]) / total);
+        }
+
+        double q_cut = q_max;
+        for (size_t k = 1; k < n_q; ++k) {
+            if (cutoff.tail[k] >= tolerance_) {
+                continue;
+            }
+
+            // Interpolate log(tail) between q_{k-1} and q_k
+            double t0 = cutoff.tail[k - 1];
+            double t1 = cutoff.tail[k];
+            double fraction = t1 > 0.0 ? std::log(t0 / tolerance_) / std::log(t0 / t1)
+                                       : (t0 - tolerance_) / (t0 - t1);
+            q_cut = (k - 1 + fraction) * DQ;
+            break;
+        }
+        cutoff.ecut = q_cut * q_cut;
+        cutoff.converged = q_cut <= 0.9 * q_max;
+
+        if (cutoff.converged || q_max >= q_limit_) {
+            break;
+        }
+        q_max = std::min(2.0 * q_max, q_limit_);
+    }
+
+    return cutoff;
+}
+
+std::vector<double> CutoffEstimator::bessel_transform(const RadialMesh& mesh, const std::vector<double>& values,
+                                                      size_t n_r, int l, double dq, size_t n_q) {
+    const std::vector<double>& r = mesh.r();
+    const std::vector<double>& weights = mesh.integration_weights();
+    std::vector<double> transform(n_q, 0.0);
+
+    // integral r^2 j_l(qr) f(r) dr with values = r f(r). The q grid is
+    // uniform, so sin(q r) and cos(q r) follow from a rotation per step
+    // instead of a trig call per point.
+    for (size_t i = 0; i < n_r; ++i) {
+        double a = weights[i] * values[i] * r[i];
+        if (a == 0.0) {
+            continue;
+        }
+
+        double dx = dq * r[i];
+        double step_s = std::sin(dx);
+        double step_c = std::cos(dx);
+        double s = 0.0;
+        double c = 1.0;
+        for (size_t k = 0; k < n_q; ++k) {
+            transform[k] += a * spherical_bessel(l, k * dx, s, c);
+            double next_s = s * step_c + c * step_s;
+            c = c * step_c - s * step_s;
+            s = next_s;
+        }
+    }
+
+    for (double& value : transform) {
+        value *= 4.0 * M_PI;
+    }
+    return transform;
+}
+
+double CutoffEstimator::spherical_bessel(int l, double x, double s, double c) {
+    // Power series where the closed forms cancel
+    if (x < std::max(0.5, static_cast<double>(l))) {
+        double prefactor = 1.0;
+        for (int n = 1; n <= l; ++n) {
+            prefactor *= x / (2 * n + 1);
+        }
+        double term = 1.0;
+        double sum = 1.0;
+        for (int k = 1; k < 40; ++k) {
+            term *= -x * x / (2.0 * k * (2 * l + 2 * k + 1));
+            sum += term;
+            if (std::abs(term) < 1e-17 * std::abs(sum)) {
+                break;
+            }
+        }
+        return prefactor * sum;
+    }
+
+    double inv = 1.0 / x;
+    double j0 = s * inv;
+    if (l == 0) {
+        return j0;
+    }
+    double j1 = (s * inv - c) * inv;
+    if (l == 1) {
+        return j1;
+    }
+    if (l == 2) {
+        return ((3.0 * inv * inv - 1.0) * s - 3.0 * inv * c) * inv;
+    }
+    if (l == 3) {
+        return ((15.0 * inv * inv - 6.0) * inv * s - (15.0 * inv * inv - 1.0) * c) * inv;
+    }
+
+    // Upward recurrence, stable for x >= l
+    for (int n = 1; n < l; ++n) {
+        double j2 = (2 * n + 1) * inv * j1 - j0;
+        j0 = j1;
+        j1 = j2;
+    }
+    return j1;
+}
+
+void CutoffEstimator::write_table(std::ostream& out) const {
+    out << "Plane-wave cutoffs (tail of q^2 |f_l(q)|^2 below " << std::scientific << std::setprecision(1)
+        << tolerance_ << ")\n\n";
+    out << std::fixed << std::setprecision(1);
+    out << std::left << std::setw(9) << "Element" << std::right << std::setw(14) << "ecutwfc (Ry)"
+        << std::setw(14) << "ecutrho (Ry)" << "  " << std::left << std::setw(18) << "limited by" << std::right
+        << std::setw(14) << "betas (Ry)" << "  file\n";
+
+    const ElementCutoff* hardest = nullptr;
+    double ecutrho = 0.0;
+    double ecut_projectors = 0.0;
+    bool projectors_converged = true;
+    size_t n_ok = 0;
+    std::set<std::string> elements;
+    for (const auto& result : results_) {
+        if (!result.ok) {
+            continue;
+        }
+        n_ok++;
+        elements.insert(result.element);
+        if (!hardest || result.ecutwfc > hardest->ecutwfc) {
+            hardest = &result;
+        }
+        ecutrho = std::max(ecutrho, result.ecutrho);
+        ecut_projectors = std::max(ecut_projectors, result.ecut_projectors);
+        projectors_converged = projectors_converged && result.projectors_converged;
+
+        // '>' marks lower bounds, the tail had not decayed at the q limit
+        std::string bound = result.converged ? " " : ">";
+        out << std::left << std::setw(9) << result.element << std::right << std::setw(13) << result.ecutwfc
+            << bound << std::setw(13) << result.ecutrho << bound << "  " << std::left << std::setw(18)
+            << result.limiting << std::right << std::setw(13) << result.ecut_projectors
+            << (result.projectors_converged ? " " : ">") << "  " << result.file.string() << "\n";
+    }
+
+    if (hardest) {
+        out << "\nAll " << elements.size() << " elements";
+        if (n_ok != elements.size()) {
+            out << " (" << n_ok << " files)";
+        }
+        out << ": ecutwfc " << hardest->ecutwfc << " Ry, ecutrho " << ecutrho
+            << " Ry (limited by " << hardest->element << " " << hardest->limiting << "), betas "
+            << (projectors_converged ? "" : ">") << ecut_projectors << " Ry\n";
+    }
+}
+
+bool CutoffEstimator::write_plots(const std::filesystem::path& root, RenderMode render_mode) const {
+    // One plot per element, variants of an element (functionals, libraries)
+    // share it, so no two tasks write the same files
+    std::map<std::string, std::vector<const ElementCutoff*>> by_element;
+    for (const auto& result : results_) {
+        if (result.ok && !result.functions.empty()) {
+            by_element[result.element].push_back(&result);
+        }
+    }
+    std::vector<std::pair<std::string, std::vector<const ElementCutoff*>>> groups(by_element.begin(),
+                                                                                   by_element.end());
+
+    std::atomic<bool> ok{true};
+    parallel_for(groups.size(), [&](size_t e) {
+        const std::string& element = groups[e].first;
+        const std::vector<const ElementCutoff*>& variants = groups[e].second;
+
+        // Columns of all variants, named after their file if there are several
+        struct Column {
+            std::string title;
+            const FunctionCutoff* function;
+        };
+        std::vector<Column> columns;
+        for (const ElementCutoff* variant : variants) {
+            std::string prefix;
+            if (variants.size() > 1) {
+                prefix = (variant->file.parent_path().filename() / variant->file.filename()).string() + " ";
+            }
+            for (const auto& function : variant->functions) {
+                columns.push_back({prefix + function.name + " (l=" + std::to_string(function.l) + ")", &function});
+            }
+        }
+
+        std::filesystem::path dir = root / element;
+        std::error_code ec;
+        std::filesystem::create_directories(dir, ec);
+        std::string data_name = element + "_cutoff_convergence.dat";
+        std::ofstream data(dir / data_name);
+        std::ofstream script(dir / "plot_cutoff_convergence.gp");
+        if (!data || !script) {
+            std::cerr << "Error: Cannot write cutoff plots to '" << dir.string() << "'\n";
+            ok = false;
+            return;
+        }
+
+        // E_cut = q^2 against the tail of every function, clamped so the
+        // log scale does not drop the converged end
+        data << "# E_cut(Ry)";
+        for (const auto& column : columns) {
+            data << "\t" << column.title;
+        }
+        data << "\n" << std::scientific;
+        // Each function has its own q range, the tail is zero beyond it
+        size_t n_q = 0;
+        for (const auto& column : columns) {
+            n_q = std::max(n_q, column.function->tail.size());
+        }
+        for (size_t k = 0; k < n_q; ++k) {
+            double q = k * DQ;
+            data << q * q;
+            for (const auto& column : columns) {
+                const std::vector<double>& tail = column.function->tail;
+                data << "\t" << std::max(k < tail.size() ? tail[k] : 0.0, 1e-16);
+            }
+            data << "\n";
+        }
+
+        std::stringstream plot_cmd;
+        plot_cmd << "plot ";
+        for (size_t i = 0; i < columns.size(); ++i) {
+            plot_cmd << "'" << data_name << "' using 1:" << (i + 2) << " with lines title '" << columns[i].title
+                     << "' noenhanced, ";
+        }
+        plot_cmd << tolerance_ << " with lines dashtype 2 title 'tolerance'";
+
+        // Same terminals and output names as every other plot
+        GnuplotExporter::write_terminals(script, render_mode, [&](const std::string& terminal,
+                                                                  const std::string& suffix,
+                                                                  const std::string& extension) {
+            GnuplotExporter::write_axes(script, "Cutoff convergence for " + element, "E_{cut} (Ry)",
+                                        "spectral weight above E_{cut}");
+            script << "set logscale y\n"
+                   << "set format y '10^{%L}'\n"
+                   << "set terminal " << terminal << "\n";
+            if (!suffix.empty()) {
+                script << "set output 'plot_cutoff_convergence" << suffix << extension << "'\n";
+            }
+            script << plot_cmd.str() << "\n\n";
+        });
+
+        if (!data || !script) {
+            ok = false;
+        }
+    });
+
+    return ok;
+}
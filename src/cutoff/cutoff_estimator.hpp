@@ -0,0 +1,87 @@
+#ifndef CUTOFF_ESTIMATOR_HPP
+#define CUTOFF_ESTIMATOR_HPP
+
+#include <filesystem>
+#include <ostream>
+#include <string>
+#include <vector>
+#include "../globals/globals.hpp"
+#include "../output/gnuplot_exporter.hpp"
+
+// Estimates plane-wave cutoffs for a set of pseudopotentials. Every beta
+// projector and pseudo wavefunction is Bessel transformed onto a fine q
+// grid,
+//     f_l(q) = 4 pi integral r^2 j_l(qr) f(r) dr,
+// and its cutoff is the energy E = q^2 (Ry) above which less than
+// `tolerance` of the spectral weight q^2 |f_l(q)|^2 remains. ecutwfc of
+// an element is the largest cutoff of its wavefunctions. The projectors
+// only enter through their overlap with the wavefunctions, their (often
+// much higher) cutoff is reported separately, it matters for real-space
+// grids. The q range of a function grows until its tail has decayed or
+// the q limit is reached. Files are parsed and functions transformed in
+// parallel.
+class CutoffEstimator {
+public:
+    static constexpr double DEFAULT_TOLERANCE = 1e-6;
+    static constexpr double Q_START = 20.0;          // bohr^-1, 400 Ry, first q range
+    static constexpr double DEFAULT_Q_LIMIT = 100.0;  // bohr^-1, 10000 Ry, largest q range
+    static constexpr double DQ = 0.02;
+
+    explicit CutoffEstimator(double tolerance = DEFAULT_TOLERANCE, double q_limit = DEFAULT_Q_LIMIT);
+
+    // Estimate the cutoffs of UPF files and of all .upf files below
+    // library directories, false if an input could not be found
+    bool run(const std::vector<std::filesystem::path>& inputs);
+
+    // Elements sorted by ecutwfc (largest first) and the cutoffs needed
+    // by all of them together
+    void write_table(std::ostream& out) const;
+
+    // Tail of every function against E_cut, one data file and script per
+    // element in <root>/<element>/, shared by all files of the element
+    bool write_plots(const std::filesystem::path& root, RenderMode render_mode) const;
+
+    struct FunctionCutoff {
+        std::string name;        // e.g. "PP_BETA.2", "PP_CHI.1 3S"
+        int l = 0;
+        bool projector = false;  // beta, not a wavefunction
+        double ecut = 0.0;       // Ry
+        bool converged = true;   // false if the tail is still above the tolerance at the q limit
+        std::vector<double> tail;  // spectral weight above q_k = k DQ, relative to the total
+    };
+
+    struct ElementCutoff {
+        std::string element;
+        std::filesystem::path file;
+        bool ok = false;            // file was parsed
+        bool augmented = false;     // ultrasoft or PAW
+        double ecutwfc = 0.0;       // Ry, from the wavefunctions (betas if there are none)
+        double ecutrho = 0.0;       // Ry
+        std::string limiting;       // function setting ecutwfc
+        bool converged = true;
+        double ecut_projectors = 0.0;  // Ry, largest beta cutoff
+        bool projectors_converged = true;
+        std::vector<FunctionCutoff> functions;
+    };
+
+    const std::vector<ElementCutoff>& results() const { return results_; }
+
+    // f_l(q_k) at q_k = k * dq for k < n_q, `values` is r f(r) as stored
+    // in UPF files, only the first `n_r` mesh points are used
+    static std::vector<double> bessel_transform(const RadialMesh& mesh, const std::vector<double>& values,
+                                                size_t n_r, int l, double dq, size_t n_q);
+
+    // Spherical Bessel function j_l(x), s = sin(x) and c = cos(x)
+    static double spherical_bessel(int l, double x, double s, double c);
+
+private:
+    double tolerance_;
+    double q_limit_;
+    std::vector<ElementCutoff> results_;
+
+    static bool collect_files(const std::filesystem::path& input, std::vector<std::filesystem::path>& files);
+    FunctionCutoff estimate(const std::string& name, int l, const RadialMesh& mesh,
+                            const std::vector<double>& values, int cutoff_index) const;
+};
+
+#endif // CUTOFF_ESTIMATOR_HPP
@@ -0,0 +1,34 @@
+#include "atomic_density.hpp"
+#include <cmath>
+#include "radial_poisson.hpp"
+
+void compute_hartree_potentials(const std::vector<UPFData*>& batch) {
+    RadialPoissonSolver solver;
+
+    // PP_NLCC is rho_core(r), the solver needs 4*pi*r^2*rho_core(r)
+    std::vector<std::vector<double>> core_densities(batch.size());
+
+    for (size_t b = 0; b < batch.size(); ++b) {
+        UPFData* data = batch[b];
+        if (!data || !data->mesh) {
+            continue;
+        }
+        ChargeDensity& density = data->density;
+        const std::vector<double>& r = data->mesh->r();
+
+        if (!density.rho_atom.empty()) {
+            solver.add(*data->mesh, density.rho_atom, density.hartree, density.valence_charge);
+        }
+
+        if (!density.nlcc.empty()) {
+            auto& core = core_densities[b];
+            core.resize(std::min(r.size(), density.nlcc.size()));
+            for (size_t i = 0; i < core.size(); ++i) {
+                core[i] = 4.0 * M_PI * r[i] * r[i] * density.nlcc[i];
+            }
+            solver.add(*data->mesh, core, density.core_hartree, density.core_charge);
+        }
+    }
+
+    solver.solve();
+}
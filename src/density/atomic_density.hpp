@@ -0,0 +1,12 @@
+#ifndef ATOMIC_DENSITY_HPP
+#define ATOMIC_DENSITY_HPP
+
+#include <vector>
+#include "../globals/globals.hpp"
+
+// Fill the Hartree potentials and charges of ChargeDensity for every
+// pseudopotential in the batch, solving all densities in one
+// RadialPoissonSolver pass. Entries without densities are left untouched.
+void compute_hartree_potentials(const std::vector<UPFData*>& batch);
+
+#endif // ATOMIC_DENSITY_HPP
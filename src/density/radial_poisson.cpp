@@ -0,0 +1,81 @@
+#include "radial_poisson.hpp"
+#include <algorithm>
+#include "../parallel/parallel.hpp"
+
+void RadialPoissonSolver::add(const RadialMesh& mesh, const std::vector<double>& density,
+                              std::vector<double>& hartree, double& charge) {
+    size_t n = std::min(mesh.size(), density.size());
+
+    Entry entry;
+    entry.offset = density_.size();
+    entry.size = n;
+    entry.hartree = &hartree;
+    entry.charge = &charge;
+    entries_.push_back(entry);
+
+    const std::vector<double>& r = mesh.r();
+    r_.insert(r_.end(), r.begin(), r.begin() + n);
+    density_.insert(density_.end(), density.begin(), density.begin() + n);
+    for (size_t i = 0; i < n; ++i) {
+        rab_.push_back(mesh.rab(i));
+    }
+}
+
+void RadialPoissonSolver::solve() {
+    size_t total = density_.size();
+
+    // Integrands of the inner and outer integral for the whole batch
+    std::vector<double> inner(total);
+    std::vector<double> outer(total);
+    for (size_t k = 0; k < total; ++k) {
+        inner[k] = density_[k] * rab_[k];
+    }
+    for (size_t k = 0; k < total; ++k) {
+        // n(r)/r vanishes at the origin, n(r) ~ r^2
+        outer[k] = r_[k] > 0.0 ? inner[k] / r_[k] : 0.0;
+    }
+
+    // Segmented prefix sums, Q(r) forward and the outer integral backward
+    parallel_for(entries_.size(), [&](size_t e) {
+        const Entry& entry = entries_[e];
+        if (entry.size == 0) {
+            return;
+        }
+        double* q = inner.data() + entry.offset;
+        double* o = outer.data() + entry.offset;
+
+        double previous = q[0];
+        q[0] = 0.0;
+        for (size_t i = 1; i < entry.size; ++i) {
+            double current = q[i];
+            q[i] = q[i - 1] + 0.5 * (previous + current);
+            previous = current;
+        }
+
+        previous = o[entry.size - 1];
+        o[entry.size - 1] = 0.0;
+        for (size_t i = entry.size - 1; i-- > 0;) {
+            double current = o[i];
+            o[i] = o[i + 1] + 0.5 * (previous + current);
+            previous = current;
+        }
+    });
+
+    // V_H = 2 * (Q/r + outer), at the origin only the outer integral remains
+    std::vector<double> hartree(total);
+    for (size_t k = 0; k < total; ++k) {
+        hartree[k] = 2.0 * ((r_[k] > 0.0 ? inner[k] / r_[k] : 0.0) + outer[k]);
+    }
+
+    // Hand the results back
+    for (const Entry& entry : entries_) {
+        entry.hartree->assign(hartree.begin() + entry.offset,
+                              hartree.begin() + entry.offset + entry.size);
+        *entry.charge = entry.size > 0 ? inner[entry.offset + entry.size - 1] : 0.0;
+    }
+
+    entries_.clear();
+    r_.clear();
+    rab_.clear();
+    density_.clear();
+}
@@ -0,0 +1,46 @@
+#ifndef RADIAL_POISSON_HPP
+#define RADIAL_POISSON_HPP
+
+#include <cstddef>
+#include <vector>
+#include "../mesh/radial_mesh.hpp"
+
+// Hartree potential of spherical charge densities, in Rydberg units:
+//
+//   V_H(r) = 2 * [ Q(r)/r + integral_r^inf n(r')/r' dr' ],  Q(r) = integral_0^r n(r') dr'
+//
+// where n(r) = 4*pi*r^2*rho(r) is the radial density as stored in PP_RHOATOM.
+// Both integrals are cumulative sums over the mesh (trapezoid rule with rab),
+// so each density costs O(N).
+//
+// Densities are added to a batch and solved together: all of them are packed
+// into one flat array, the element-wise steps run over the whole batch in
+// single loops and the prefix sums run in parallel, one per density.
+class RadialPoissonSolver {
+public:
+    // Queue a density, the results are written to hartree and charge by solve()
+    void add(const RadialMesh& mesh, const std::vector<double>& density,
+             std::vector<double>& hartree, double& charge);
+
+    // Solve every queued density and clear the batch
+    void solve();
+
+    size_t size() const { return entries_.size(); }
+
+private:
+    struct Entry {
+        size_t offset;
+        size_t size;
+        std::vector<double>* hartree;
+        double* charge;
+    };
+
+    std::vector<Entry> entries_;
+
+    // Packed batch data
+    std::vector<double> r_;
+    std::vector<double> rab_;
+    std::vector<double> density_;
+};
+
+#endif // RADIAL_POISSON_HPP
@@ -0,0 +1,328 @@
+#include "library_diff.hpp"
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <map>
+#include <string_view>
+#include "../UPF_reader/UPF_reader.hpp"
+#include "../parallel/parallel.hpp"
+
+LibraryDiff::LibraryDiff(const std::filesystem::path& old_root, const std::filesystem::path& new_root)
+    : old_root_(old_root), new_root_(new_root) {
+}
+
+bool LibraryDiff::run() {
+    results_.clear();
+    only_old_.clear();
+    only_new_.clear();
+
+    std::vector<LibraryFile> old_files;
+    std::vector<LibraryFile> new_files;
+    if (!scan_library(old_root_, old_files) || !scan_library(new_root_, new_files)) {
+        return false;
+    }
+
+    // Pair the files by element, the first file (by path) wins on duplicates
+    auto index_by_element = [](const std::vector<LibraryFile>& files, const std::filesystem::path& root) {
+        std::map<std::string, size_t> index;
+        for (size_t i = 0; i < files.size(); ++i) {
+            if (!files[i].ok) {
+                std::cerr << "Warning: Could not read '" << files[i].path.string() << "'\n";
+                continue;
+            }
+            if (!index.emplace(files[i].element, i).second) {
+                std::cerr << "Warning: Element " << files[i].element << " appears more than once in '"
+                          << root.string() << "', using '" << files[index[files[i].element]].path.string()
+                          << "'\n";
+            }
+        }
+        return index;
+    };
+    auto old_index = index_by_element(old_files, old_root_);
+    auto new_index = index_by_element(new_files, new_root_);
+
+    std::vector<std::pair<size_t, size_t>> pairs;
+    for (const auto& [element, i] : old_index) {
+        auto it = new_index.find(element);
+        if (it == new_index.end()) {
+            only_old_.push_back(element);
+            continue;
+        }
+        pairs.emplace_back(i, it->second);
+
+        ElementDiff diff;
+        diff.element = element;
+        diff.old_file = old_files[i].path;
+        diff.new_file = new_files[it->second].path;
+        results_.push_back(diff);
+    }
+    for (const auto& [element, _] : new_index) {
+        if (old_index.find(element) == old_index.end()) {
+            only_new_.push_back(element);
+        }
+    }
+
+    // Compare the pairs in parallel, each one only touches its own result
+    parallel_for(pairs.size(), [&](size_t p) {
+        LibraryFile& old_file = old_files[pairs[p].first];
+        LibraryFile& new_file = new_files[pairs[p].second];
+        ElementDiff& diff = results_[p];
+
+        if (old_file.hash == new_file.hash && old_file.contents == new_file.contents) {
+            diff.identical = true;
+            return;
+        }
+
+        UPFReader old_reader(old_file.path.string());
+        UPFReader new_reader(new_file.path.string());
+        if (!old_reader.load_buffer(std::move(old_file.contents)) ||
+            !new_reader.load_buffer(std::move(new_file.contents))) {
+            diff.failed = true;
+            return;
+        }
+
+        compare(old_reader.data(), new_reader.data(), diff);
+    });
+
+    // Largest difference first
+    std::stable_sort(results_.begin(), results_.end(), [](const ElementDiff& a, const ElementDiff& b) {
+        return a.score > b.score;
+    });
+
+    return true;
+}
+
+void LibraryDiff::write_report(std::ostream& out) const {
+    out << "Library diff: " << old_root_.string() << " -> " << new_root_.string() << "\n\n";
+
+    std::vector<std::string> identical;
+    std::vector<std::string> unchanged;
+    std::vector<std::string> failed;
+
+    out << "Changed elements (largest L2 difference first):\n";
+    out << std::scientific << std::setprecision(3);
+    bool any_changed = false;
+    for (const auto& diff : results_) {
+        if (diff.identical) {
+            identical.push_back(diff.element);
+            continue;
+        }
+        if (diff.failed) {
+            failed.push_back(diff.element);
+            continue;
+        }
+        if (diff.score == 0.0) {
+            unchanged.push_back(diff.element);
+            continue;
+        }
+
+        any_changed = true;
+        out << "  " << std::left << std::setw(4) << diff.element << std::right
+            << " score " << diff.score << (diff.mesh_changed ? "  [mesh changed]" : "") << "\n";
+        for (const auto& function : diff.functions) {
+            if (function.note.empty() && function.linf == 0.0) {
+                continue;
+            }
+            out << "      " << std::left << std::setw(18) << function.name << std::right;
+            if (!function.note.empty()) {
+                out << function.note << "\n";
+            } else {
+                out << "L2 " << function.l2 << "  Linf " << function.linf << "\n";
+            }
+        }
+    }
+    if (!any_changed) {
+        out << "  (none)\n";
+    }
+
+    auto write_list = [&out](const std::string& title, const std::vector<std::string>& elements) {
+        if (elements.empty()) {
+            return;
+        }
+        out << "\n" << title << " (" << elements.size() << "):";
+        for (const auto& element : elements) {
+            out << " " << element;
+        }
+        out << "\n";
+    };
+    write_list("Identical files", identical);
+    write_list("Different files, equal values", unchanged);
+    write_list("Failed to parse", failed);
+    write_list("Only in " + old_root_.string(), only_old_);
+    write_list("Only in " + new_root_.string(), only_new_);
+}
+
+bool LibraryDiff::scan_library(const std::filesystem::path& root, std::vector<LibraryFile>& files) {
+    std::error_code ec;
+    if (!std::filesystem::is_directory(root, ec)) {
+        std::cerr << "Error: Library directory '" << root.string() << "' not found\n";
+        return false;
+    }
+
+    for (const auto& entry : std::filesystem::recursive_directory_iterator(root, ec)) {
+        std::string extension = entry.path().extension().string();
+        std::transform(extension.begin(), extension.end(), extension.begin(),
+                       [](unsigned char c) { return std::tolower(c); });
+        if (entry.is_regular_file() && extension == ".upf") {
+            LibraryFile file;
+            file.path = entry.path();
+            files.push_back(std::move(file));
+        }
+    }
+    std::sort(files.begin(), files.end(), [](const LibraryFile& a, const LibraryFile& b) {
+        return a.path < b.path;
+    });
+
+    // Read, hash and identify every file in parallel
+    parallel_for(files.size(), [&](size_t i) {
+        LibraryFile& file = files[i];
+        std::ifstream in(file.path, std::ios::binary);
+        if (!in) {
+            return;
+        }
+        file.contents.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+        file.hash = hash_contents(file.contents);
+        file.element = header_element(file.contents, file.path);
+        file.ok = true;
+    });
+
+    return true;
+}
+
+std::string LibraryDiff::header_element(const std::vector<char>& contents, const std::filesystem::path& path) {
+    // element="Si" inside PP_HEADER, found without parsing the whole file
+    std::string_view text(contents.data(), contents.size());
+    size_t header = text.find("<PP_HEADER");
+    size_t attribute = header == std::string_view::npos ? header : text.find("element=\"", header);
+    if (attribute != std::string_view::npos) {
+        size_t start = attribute + 9;
+        size_t end = text.find('"', start);
+        if (end != std::string_view::npos) {
+            std::string element(text.substr(start, end - start));
+            element.erase(std::remove_if(element.begin(), element.end(),
+                                         [](unsigned char c) { return std::isspace(c); }),
+                          element.end());
+            if (!element.empty()) {
+                return element;
+            }
+        }
+    }
+
+    // Fall back to the file name up to the first '.', '_' or '-'
+    std::string stem = path.filename().string();
+    return stem.substr(0, stem.find_first_of("._-"));
+}
+
+uint64_t LibraryDiff::hash_contents(const std::vector<char>& contents) {
+    // FNV-1a
+    uint64_t hash = 14695981039346656037ull;
+    for (char c : contents) {
+        hash ^= static_cast<unsigned char>(c);
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+void LibraryDiff::compare(const UPFData& old_data, const UPFData& new_data, ElementDiff& diff) {
+    // Meshes are interned, equal meshes share one instance
+    diff.mesh_changed = old_data.mesh != new_data.mesh;
+
+    diff.functions.push_back(compare_function("PP_LOCAL", old_data, old_data.local_potential,
+                                              new_data, new_data.local_potential));
+
+    size_t n_beta = std::max(old_data.betas.size(), new_data.betas.size());
+    for (size_t i = 0; i < n_beta; ++i) {
+        static const std::vector<double> missing;
+        const auto& a = i < old_data.betas.size() ? old_data.betas[i].values : missing;
+        const auto& b = i < new_data.betas.size() ? new_data.betas[i].values : missing;
+        diff.functions.push_back(compare_function("PP_BETA." + std::to_string(i + 1),
+                                                  old_data, a, new_data, b));
+    }
+
+    size_t n_chi = std::max(old_data.chis.size(), new_data.chis.size());
+    for (size_t i = 0; i < n_chi; ++i) {
+        static const std::vector<double> missing;
+        const auto& a = i < old_data.chis.size() ? old_data.chis[i].values : missing;
+        const auto& b = i < new_data.chis.size() ? new_data.chis[i].values : missing;
+        std::string label = i < old_data.chis.size() ? old_data.chis[i].label : new_data.chis[i].label;
+        diff.functions.push_back(compare_function("PP_CHI." + std::to_string(i + 1) + " " + label,
+                                                  old_data, a, new_data, b));
+    }
+
+    // D_ij is a matrix, compare it element by element
+    FunctionDiff dij{"PP_DIJ", 0.0, 0.0, ""};
+    if (old_data.dij.size() != new_data.dij.size()) {
+        dij.note = "size changed (" + std::to_string(old_data.dij.size()) + " -> " +
+                   std::to_string(new_data.dij.size()) + ")";
+    } else {
+        double sum = 0.0;
+        for (size_t i = 0; i < old_data.dij.size(); ++i) {
+            double d = new_data.dij[i] - old_data.dij[i];
+            sum += d * d;
+            dij.linf = std::max(dij.linf, std::abs(d));
+        }
+        dij.l2 = std::sqrt(sum);
+    }
+    diff.functions.push_back(dij);
+
+    // Structural changes rank before any numerical difference
+    for (const auto& function : diff.functions) {
+        double score = function.note.empty() ? function.l2 : std::numeric_limits<double>::infinity();
+        diff.score = std::max(diff.score, score);
+    }
+}
+
+LibraryDiff::FunctionDiff LibraryDiff::compare_function(const std::string& name,
+                                                        const UPFData& old_data, const std::vector<double>& a,
+                                                        const UPFData& new_data, const std::vector<double>& b) {
+    FunctionDiff result{name, 0.0, 0.0, ""};
+    if (a.empty() && b.empty()) {
+        return result;
+    }
+    if (a.empty() || b.empty()) {
+        result.note = a.empty() ? "only in new version" : "only in old version";
+        return result;
+    }
+
+    const RadialMesh& mesh = *old_data.mesh;
+    const std::vector<double>& r = mesh.r();
+    const std::vector<double>& weights = mesh.integration_weights();
+    size_t n = std::min(a.size(), r.size());
+
+    // New values on the old mesh, interpolated where the meshes differ
+    size_t first = 0;
+    std::vector<double> b_on_a(n);
+    if (old_data.mesh == new_data.mesh) {
+        n = std::min(n, b.size());
+        std::copy(b.begin(), b.begin() + n, b_on_a.begin());
+    } else {
+        // Only compare where both meshes are defined, points outside the
+        // new mesh would compare against a clamped end value
+        const std::vector<double>& r_new = new_data.mesh->r();
+        double r_max = r_new[std::min(b.size(), r_new.size()) - 1];
+        n = std::upper_bound(r.begin(), r.begin() + n, r_max) - r.begin();
+        first = std::lower_bound(r.begin(), r.begin() + n, r_new.front()) - r.begin();
+
+        auto interpolation = new_data.mesh->interpolation_to(mesh);
+        for (size_t k = first; k < n; ++k) {
+            size_t i = interpolation->index[k];
+            double w = interpolation->weight[k];
+            b_on_a[k] = (1.0 - w) * b[i] + w * b[std::min(i + 1, b.size() - 1)];
+        }
+    }
+
+    double sum = 0.0;
+    for (size_t k = first; k < n; ++k) {
+        double d = b_on_a[k] - a[k];
+        sum += weights[k] * d * d;
+        result.linf = std::max(result.linf, std::abs(d));
+    }
+    result.l2 = std::sqrt(std::max(sum, 0.0));
+
+    return result;
+}
@@ -0,0 +1,72 @@
+#ifndef LIBRARY_DIFF_HPP
+#define LIBRARY_DIFF_HPP
+
+#include <cstdint>
+#include <filesystem>
+#include <ostream>
+#include <string>
+#include <vector>
+#include "../globals/globals.hpp"
+
+// Compares two versions of a pseudopotential library, e.g. an old and a
+// regenerated UPF_data/ directory. Files are paired by the element in their
+// header, byte-identical pairs are skipped by hash and all other pairs are
+// compared in parallel: PP_LOCAL, every beta, every chi and D_ij. When the
+// meshes differ the new version is interpolated onto the old mesh.
+class LibraryDiff {
+public:
+    LibraryDiff(const std::filesystem::path& old_root, const std::filesystem::path& new_root);
+
+    // Pair and compare all files, false if a library could not be read
+    bool run();
+
+    // Changed elements, largest difference first, then unchanged and unpaired ones
+    void write_report(std::ostream& out) const;
+
+    // Difference of one function between the two versions
+    struct FunctionDiff {
+        std::string name;  // e.g. "PP_LOCAL", "PP_BETA.2", "PP_DIJ"
+        double l2;         // sqrt(integral (a - b)^2 dr), plain 2-norm for D_ij
+        double linf;       // max |a - b|
+        std::string note;  // set when the function exists in only one version
+    };
+
+    struct ElementDiff {
+        std::string element;
+        std::filesystem::path old_file;
+        std::filesystem::path new_file;
+        bool identical = false;     // same file contents (hash)
+        bool failed = false;        // one of the files could not be parsed
+        bool mesh_changed = false;  // compared after interpolation
+        std::vector<FunctionDiff> functions;
+        double score = 0.0;         // largest L2 difference of all functions
+    };
+
+    const std::vector<ElementDiff>& results() const { return results_; }
+
+private:
+    struct LibraryFile {
+        std::filesystem::path path;
+        std::vector<char> contents;
+        uint64_t hash = 0;
+        std::string element;
+        bool ok = false;
+    };
+
+    std::filesystem::path old_root_;
+    std::filesystem::path new_root_;
+    std::vector<ElementDiff> results_;
+    std::vector<std::string> only_old_;
+    std::vector<std::string> only_new_;
+
+    static bool scan_library(const std::filesystem::path& root, std::vector<LibraryFile>& files);
+    static std::string header_element(const std::vector<char>& contents, const std::filesystem::path& path);
+    static uint64_t hash_contents(const std::vector<char>& contents);
+
+    static void compare(const UPFData& old_data, const UPFData& new_data, ElementDiff& diff);
+    static FunctionDiff compare_function(const std::string& name,
+                                         const UPFData& old_data, const std::vector<double>& a,
+                                         const UPFData& new_data, const std::vector<double>& b);
+};
+
+#endif // LIBRARY_DIFF_HPP
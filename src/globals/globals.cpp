@@ -1,18 +1,14 @@
 #include "globals.hpp"
+#include <utility>
 
 // Global flag indicating if UPF data is valid
 bool g_upf_data_valid = false;
 
 // Global UPF header data
-struct UPFHeader g_upf_header = {
-    "",  // element
-    "",  // pseudo_type
-    0,    // z_valence
-    false // relativistic
-};
+struct UPFHeader g_upf_header;
 
 // Global mesh data
-std::vector<double> g_r_mesh;
+std::shared_ptr<const RadialMesh> g_mesh;
 
 // Global orbital data
 std::map<int, std::vector<GlobalOrbitalData>> g_orbitals;
@@ -22,3 +18,52 @@ std::vector<double> g_local_potential;
 std::map<int, std::vector<double>> g_nonlocal_potentials;
 std::map<int, std::vector<double>> g_projectors;
 std::map<int, std::vector<double>> g_total_potentials;
+std::vector<BetaFunction> g_betas;
+std::vector<double> g_dij;
+std::vector<ChiFunction> g_chis;
+
+// Global charge density data
+ChargeDensity g_density;
+
+// Global ultrasoft/PAW data
+AugmentationData g_augmentation;
+PAWData g_paw;
+
+std::string trimmed(const std::string& text) {
+    size_t first = text.find_first_not_of(" \t\r\n");
+    size_t last = text.find_last_not_of(" \t\r\n");
+    return first == std::string::npos ? "" : text.substr(first, last - first + 1);
+}
+
+const AugmentationBlock* AugmentationData::find(int i, int j, int l) const {
+    if (i > j) {
+        std::swap(i, j);
+    }
+    if (i < 0 || j >= nbeta || l < -1 || l > l_max_aug) {
+        return nullptr;
+    }
+    size_t slot = pair_index(i, j) * (l_max_aug + 2) + (l + 1);
+    if (slot >= block_index.size() || block_index[slot] < 0) {
+        return nullptr;
+    }
+    return &blocks[block_index[slot]];
+}
+
+UPFData snapshot_globals() {
+    UPFData data;
+    data.valid = g_upf_data_valid;
+    data.header = g_upf_header;
+    data.mesh = g_mesh;
+    data.orbitals = g_orbitals;
+    data.local_potential = g_local_potential;
+    data.nonlocal_potentials = g_nonlocal_potentials;
+    data.projectors = g_projectors;
+    data.total_potentials = g_total_potentials;
+    data.betas = g_betas;
+    data.dij = g_dij;
+    data.chis = g_chis;
+    data.density = g_density;
+    data.augmentation = g_augmentation;
+    data.paw = g_paw;
+    return data;
+}
@@ -4,10 +4,27 @@
 #include <string>
 #include <vector>
 #include <map>
+#include <memory>
+#include "../mesh/radial_mesh.hpp"
 
 // Forward declare UPFReader to avoid circular dependency
 class UPFReader;
 
+// Program exit codes
+enum ExitCode {
+    SUCCESS = 0,
+    ERROR_INVALID_ARGS = 1,
+    ERROR_FILE_NOT_FOUND = 2,
+    ERROR_FILE_READ = 3,
+    ERROR_XML_PARSE = 4,
+    ERROR_FILE_WRITE = 5,
+    ERROR_RENDER = 6
+};
+
+// Text without leading and trailing blanks, e.g. the padded element field
+// of PP_HEADER ("B ")
+std::string trimmed(const std::string& text);
+
 // Global flag indicating if UPF data is valid
 extern bool g_upf_data_valid;
 
@@ -15,17 +32,19 @@ extern bool g_upf_data_valid;
 struct UPFHeader {
     std::string element;
     std::string pseudo_type;
-    double z_valence;
-    int mesh_size;
-    int l_max;
-    bool is_ultrasoft;
-    bool has_so;
+    double z_valence = 0.0;
+    int mesh_size = 0;
+    int l_max = 0;
+    bool is_ultrasoft = false;
+    bool has_so = false;
+    bool is_paw = false;
+    int number_of_proj = 0;
 };
 
 extern UPFHeader g_upf_header;
 
-// Global mesh data
-extern std::vector<double> g_r_mesh;
+// Global mesh data (shared with every other file on the same mesh)
+extern std::shared_ptr<const RadialMesh> g_mesh;
 
 // Global orbital data structure
 struct GlobalOrbitalData {
@@ -37,10 +56,115 @@ struct GlobalOrbitalData {
 // Global orbitals map
 extern std::map<int, std::vector<GlobalOrbitalData>> g_orbitals;  // Key is UPFReader::OrbitalType
 
+// One PP_BETA.n projector as stored in the file
+struct BetaFunction {
+    int index;                // n of PP_BETA.n (1-based)
+    int l;                    // angular_momentum
+    int cutoff_radius_index;  // last mesh point where the projector is nonzero
+    double cutoff_radius;
+    std::vector<double> values;
+};
+
+// One PP_CHI.n pseudo wavefunction as stored in the file
+struct ChiFunction {
+    int index;          // n of PP_CHI.n (1-based)
+    int l;              // l
+    std::string label;  // e.g. "3S"
+    double occupation;
+    std::vector<double> values;
+};
+
 // Global variables declarations
 extern std::vector<double> g_local_potential;
 extern std::map<int, std::vector<double>> g_nonlocal_potentials;  // Key is UPFReader::QuantumNumber
 extern std::map<int, std::vector<double>> g_projectors;  // Key is UPFReader::QuantumNumber
 extern std::map<int, std::vector<double>> g_total_potentials; // V_l^total(r) = V_local(r) + V_l^nonlocal(r) * P_l(r)
+extern std::vector<BetaFunction> g_betas;  // All PP_BETA.n in file order
+extern std::vector<double> g_dij;          // PP_DIJ, number_of_proj x number_of_proj, row major
+extern std::vector<ChiFunction> g_chis;    // All PP_CHI.n in file order
+
+// One augmentation function Q_ij(r) or Q_ij^L(r) from PP_AUGMENTATION
+struct AugmentationBlock {
+    int i;          // first beta index (0-based)
+    int j;          // second beta index (0-based), j >= i
+    int l;          // angular momentum L of PP_QIJL, -1 for PP_QIJ
+    size_t offset;  // start of the block in AugmentationData::values
+    size_t size;    // number of stored mesh points
+};
+
+// Augmentation charges of ultrasoft/PAW pseudopotentials.
+// Q_ij = Q_ji, so only blocks with i <= j are kept. All blocks are packed
+// one after another in `values`, each truncated to the augmentation cutoff.
+struct AugmentationData {
+    bool present = false;
+    bool q_with_l = false;
+    int nbeta = 0;
+    int l_max_aug = 0;
+    int cutoff_r_index = 0;
+    std::vector<double> q;           // PP_Q, nbeta x nbeta integrals of Q_ij(r)
+    std::vector<double> multipoles;  // PP_MULTIPOLES (PAW only)
+    std::vector<AugmentationBlock> blocks;
+    std::vector<int> block_index;    // (pair, L + 1) -> index into blocks, -1 if absent
+    std::vector<double> values;
+
+    // Index of the (i <= j) pair in the packed upper triangle
+    static size_t pair_index(int i, int j) {
+        return static_cast<size_t>(j) * (j + 1) / 2 + i;
+    }
+
+    // Block for Q_ij^L (L = -1 for PP_QIJ), nullptr if it is not in the file
+    const AugmentationBlock* find(int i, int j, int l) const;
+};
+
+// PAW specific data (PP_PAW and PP_FULL_WFC)
+struct PAWData {
+    bool present = false;
+    double core_energy = 0.0;
+    std::vector<double> occupations;  // PP_OCCUPATIONS
+    std::vector<double> ae_nlcc;      // PP_AE_NLCC
+    std::vector<double> ae_vloc;      // PP_AE_VLOC
+    std::vector<std::vector<double>> ae_wfc;  // PP_AEWFC.n
+    std::vector<std::vector<double>> ps_wfc;  // PP_PSWFC.n
+};
+
+// Atomic charge densities and their Hartree potentials
+struct ChargeDensity {
+    std::vector<double> rho_atom;      // PP_RHOATOM, 4*pi*r^2*rho_atom(r)
+    std::vector<double> nlcc;          // PP_NLCC, core charge rho_core(r)
+    std::vector<double> hartree;       // V_H(r) of rho_atom (Ry)
+    std::vector<double> core_hartree;  // V_H(r) of rho_core (Ry)
+    double valence_charge = 0.0;       // integral of PP_RHOATOM
+    double core_charge = 0.0;          // integral of 4*pi*r^2*rho_core(r)
+};
+
+// Global charge density data
+extern ChargeDensity g_density;
+
+// Global ultrasoft/PAW data
+extern AugmentationData g_augmentation;
+extern PAWData g_paw;
+
+// Self-contained copy of the global UPF data, so it can be handed to
+// another thread (e.g. the asynchronous writer) while the next file is parsed.
+// Also the per-file result of UPFReader::load().
+struct UPFData {
+    bool valid = false;
+    UPFHeader header;
+    std::shared_ptr<const RadialMesh> mesh;
+    std::map<int, std::vector<GlobalOrbitalData>> orbitals;
+    std::vector<double> local_potential;
+    std::map<int, std::vector<double>> nonlocal_potentials;
+    std::map<int, std::vector<double>> projectors;
+    std::map<int, std::vector<double>> total_potentials;
+    std::vector<BetaFunction> betas;
+    std::vector<double> dij;
+    std::vector<ChiFunction> chis;
+    ChargeDensity density;
+    AugmentationData augmentation;
+    PAWData paw;
+};
+
+// Copy the current global UPF data into a snapshot
+UPFData snapshot_globals();
 
 #endif // GLOBALS_HPP
@@ -5,10 +5,188 @@ bool file_exists(const std::string& filename) {
 }
 
 void print_usage(const char* program_name) {
-    std::cerr << "Usage: " << program_name << " <upf_file>\n";
+    std::cerr << "Usage: " << program_name << " [options] <upf_file> [upf_file ...]\n";
     std::cerr << "Read and process Universal Pseudopotential File (UPF)\n";
     std::cerr << "Arguments:\n";
     std::cerr << "  upf_file   Path to the UPF file to process\n";
+    std::cerr << "Options:\n";
+    std::cerr << "  --headless       Write non-interactive gnuplot scripts (PNG, PDF, EPS)\n";
+    std::cerr << "  --multiplot      Also write one multiplot script per element\n";
+    std::cerr << "  --render         Write headless scripts and run gnuplot on them in parallel\n";
+    std::cerr << "  --gnuplot <exe>  gnuplot binary used by --render (default: gnuplot)\n";
+    std::cerr << "  --manifest <file>  Also process the UPF files listed in <file>, one per line\n";
+    std::cerr << "  --shard <i>/<N>  Only process input i of every N (0 <= i < N) and write\n";
+    std::cerr << "                   the results to gnuplot/" << SHARD_DIR << "/\n";
+    std::cerr << "Commands:\n";
+    std::cerr << "  " << program_name << " diff <old_library> <new_library>\n";
+    std::cerr << "             Compare two library directories element by element\n";
+    std::cerr << "  " << program_name << " merge [output_dir]\n";
+    std::cerr << "             Combine the shard results below output_dir (default: gnuplot)\n";
+    std::cerr << "             into " << ShardMerge::SUMMARY_FILE << " and " << ShardMerge::INDEX_FILE << ", fails while\n";
+    std::cerr << "             shards are missing or files failed\n";
+    std::cerr << "  " << program_name
+              << " cutoff [--tolerance <t>] [--qmax <q>] [--headless] <library_dir|upf_file> ...\n";
+    std::cerr << "             Estimate ecutwfc/ecutrho from the Bessel transforms of the betas\n";
+    std::cerr << "             and wavefunctions (default tolerance " << CutoffEstimator::DEFAULT_TOLERANCE << ")\n";
+    std::cerr << "             up to q = qmax bohr^-1 (default " << CutoffEstimator::DEFAULT_Q_LIMIT << ")\n";
+    std::cerr << "  " << program_name << " grid [--spacing <h>] [--output <file>] <structure_file>\n";
+    std::cerr << "             Sample the projectors and local potentials of all atoms on the\n";
+    std::cerr << "             real-space grid of the cell (default output: <structure_file>.grid)\n";
+}
+
+int run_diff(int argc, char* argv[]) {
+    if (argc != 4) {
+        print_usage(argv[0]);
+        return ERROR_INVALID_ARGS;
+    }
+
+    LibraryDiff diff(argv[2], argv[3]);
+    if (!diff.run()) {
+        return ERROR_FILE_NOT_FOUND;
+    }
+
+    diff.write_report(std::cout);
+    return SUCCESS;
+}
+
+int run_merge(int argc, char* argv[]) {
+    if (argc > 3) {
+        print_usage(argv[0]);
+        return ERROR_INVALID_ARGS;
+    }
+
+    ShardMerge merge(argc == 3 ? argv[2] : "gnuplot");
+    if (!merge.run()) {
+        return ERROR_FILE_NOT_FOUND;
+    }
+    if (!merge.write_files()) {
+        return ERROR_FILE_WRITE;
+    }
+
+    merge.write_summary(std::cout);
+
+    // Fail until every shard has reported and every file was processed
+    if (!merge.complete()) {
+        return ERROR_FILE_NOT_FOUND;
+    }
+    return merge.all_ok() ? SUCCESS : ERROR_FILE_READ;
+}
+
+int run_cutoff(int argc, char* argv[]) {
+    double tolerance = CutoffEstimator::DEFAULT_TOLERANCE;
+    double q_limit = CutoffEstimator::DEFAULT_Q_LIMIT;
+    RenderMode render_mode = RenderMode::INTERACTIVE;
+    std::vector<std::filesystem::path> inputs;
+    for (int i = 2; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--tolerance") {
+            char* end = nullptr;
+            tolerance = i + 1 < argc ? std::strtod(argv[i + 1], &end) : 0.0;
+            if (!end || *end != '\0' || !(tolerance > 0.0 && tolerance < 1.0)) {
+                std::cerr << "Error: --tolerance expects a number between 0 and 1\n";
+                return ERROR_INVALID_ARGS;
+            }
+            ++i;
+            continue;
+        }
+        if (arg == "--qmax") {
+            char* end = nullptr;
+            q_limit = i + 1 < argc ? std::strtod(argv[i + 1], &end) : 0.0;
+            if (!end || *end != '\0' || !(q_limit >= CutoffEstimator::DQ)) {
+                std::cerr << "Error: --qmax expects a positive number (bohr^-1)\n";
+                return ERROR_INVALID_ARGS;
+            }
+            ++i;
+            continue;
+        }
+        if (arg == "--headless") {
+            render_mode = RenderMode::HEADLESS;
+            continue;
+        }
+        inputs.push_back(arg);
+    }
+
+    if (inputs.empty()) {
+        print_usage(argv[0]);
+        return ERROR_INVALID_ARGS;
+    }
+
+    CutoffEstimator estimator(tolerance, q_limit);
+    if (!estimator.run(inputs)) {
+        return ERROR_FILE_NOT_FOUND;
+    }
+
+    estimator.write_table(std::cout);
+    if (!estimator.write_plots("gnuplot", render_mode)) {
+        return ERROR_FILE_WRITE;
+    }
+
+    return SUCCESS;
+}
+
+int run_grid(int argc, char* argv[]) {
+    double spacing = 0.0;
+    std::filesystem::path output;
+    std::filesystem::path structure_file;
+    for (int i = 2; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--spacing") {
+            char* end = nullptr;
+            spacing = i + 1 < argc ? std::strtod(argv[i + 1], &end) : 0.0;
+            if (!end || *end != '\0' || !(spacing > 0.0)) {
+                std::cerr << "Error: --spacing expects a positive number (bohr)\n";
+                return ERROR_INVALID_ARGS;
+            }
+            ++i;
+            continue;
+        }
+        if (arg == "--output") {
+            if (i + 1 >= argc) {
+                print_usage(argv[0]);
+                return ERROR_INVALID_ARGS;
+            }
+            output = argv[++i];
+            continue;
+        }
+        if (!structure_file.empty()) {
+            print_usage(argv[0]);
+            return ERROR_INVALID_ARGS;
+        }
+        structure_file = arg;
+    }
+
+    if (structure_file.empty()) {
+        print_usage(argv[0]);
+        return ERROR_INVALID_ARGS;
+    }
+    if (!file_exists(structure_file.string())) {
+        std::cerr << "Error: File '" << structure_file.string() << "' not found\n";
+        return ERROR_FILE_NOT_FOUND;
+    }
+
+    GridStructure structure;
+    if (!GridStructure::read(structure_file, structure)) {
+        return ERROR_FILE_READ;
+    }
+    if (spacing > 0.0) {
+        structure.spacing = spacing;
+    }
+    if (output.empty()) {
+        output = structure_file;
+        output += ".grid";
+    }
+
+    ProjectorGrid grid(std::move(structure));
+    if (!grid.build()) {
+        return ERROR_FILE_READ;
+    }
+    if (!grid.write(output)) {
+        return ERROR_FILE_WRITE;
+    }
+
+    grid.write_summary(std::cout);
+    std::cout << "Written to " << output.string() << "\n";
+    return SUCCESS;
 }
 
 int main(int argc, char* argv[]) {
@@ -18,45 +196,125 @@ int main(int argc, char* argv[]) {
         return ERROR_INVALID_ARGS;
     }
 
+    // Commands
+    if (std::string(argv[1]) == "diff") {
+        return run_diff(argc, argv);
+    }
+    if (std::string(argv[1]) == "merge") {
+        return run_merge(argc, argv);
+    }
+    if (std::string(argv[1]) == "cutoff") {
+        return run_cutoff(argc, argv);
+    }
+    if (std::string(argv[1]) == "grid") {
+        return run_grid(argc, argv);
+    }
+
+    ExportOptions options;
+    bool render = false;
+    std::string gnuplot = "gnuplot";
+    bool sharded = false;
+    bool manifest = false;
+    ShardSpec shard;
+
+    std::vector<std::string> upf_filenames;
     for (int i = 1; i < argc; ++i) {
         std::string upf_filename = argv[i];
 
-        // Check if file exists
-        if (!file_exists(upf_filename)) {
-            std::cerr << "Error: File '" << upf_filename << "' not found\n";
-            return ERROR_FILE_NOT_FOUND;
+        // Options
+        if (upf_filename == "--headless") {
+            options.render_mode = RenderMode::HEADLESS;
+            continue;
+        }
+        if (upf_filename == "--multiplot") {
+            options.multiplot = true;
+            continue;
+        }
+        if (upf_filename == "--render") {
+            options.render_mode = RenderMode::HEADLESS;
+            render = true;
+            continue;
+        }
+        if (upf_filename == "--gnuplot") {
+            if (i + 1 >= argc) {
+                print_usage(argv[0]);
+                return ERROR_INVALID_ARGS;
+            }
+            gnuplot = argv[++i];
+            continue;
+        }
+        if (upf_filename == "--manifest") {
+            if (i + 1 >= argc) {
+                print_usage(argv[0]);
+                return ERROR_INVALID_ARGS;
+            }
+            if (!read_manifest(argv[++i], upf_filenames)) {
+                return ERROR_FILE_NOT_FOUND;
+            }
+            manifest = true;
+            continue;
+        }
+        if (upf_filename == "--shard") {
+            if (i + 1 >= argc || !ShardSpec::parse(argv[i + 1], shard)) {
+                std::cerr << "Error: --shard expects <i>/<N> with 0 <= i < N\n";
+                return ERROR_INVALID_ARGS;
+            }
+            sharded = true;
+            ++i;
+            continue;
         }
 
-        try {
-            // Create UPF reader instance
-            UPFReader reader(upf_filename);
+        upf_filenames.push_back(upf_filename);
+    }
 
-            // Read and parse the UPF file
-            if (!reader.parse()) {
-                std::cerr << "Error: Failed to parse UPF file\n";
-                return ERROR_XML_PARSE;
-            }
+    if (upf_filenames.empty()) {
+        print_usage(argv[0]);
+        return ERROR_INVALID_ARGS;
+    }
 
-            // Process and display the UPF data
-            reader.display_info();
+    // Every shard sees the same input list and keeps its own part of it
+    std::string run;
+    if (sharded) {
+        run = run_id(upf_filenames);
+        upf_filenames = shard.select(upf_filenames);
+    }
 
-            // Get element name from global header
-            std::string element = g_upf_header.element;
+    // Check if the files exist, a shard records missing files in its
+    // results and goes on with the others
+    for (const auto& upf_filename : upf_filenames) {
+        if (!sharded && !file_exists(upf_filename)) {
+            std::cerr << "Error: File '" << upf_filename << "' not found\n";
+            return ERROR_FILE_NOT_FOUND;
+        }
+    }
 
-            // Create output directory for this element
-            std::string output_dir = "gnuplot/" + element;
+    // Read, parse and export the files in overlapping stages
+    auto start = std::chrono::steady_clock::now();
+    Pipeline pipeline(std::move(upf_filenames), options);
 
-            // Export data using gnuplot exporter with element name
-            GnuplotExporter exporter(output_dir, element);
-            if (!exporter.export_all()) {
-                std::cerr << "Error: Failed to export orbital data\n";
-                return ERROR_FILE_WRITE;
-            }
-        } catch (const std::exception& e) {
-            std::cerr << "Error: " << e.what() << "\n";
-            return ERROR_FILE_READ;
+    // Sweeps list several variants of an element, give every file its own directory
+    pipeline.set_unique_output_dirs(sharded || manifest);
+    pipeline.set_keep_going(sharded);
+    ExitCode status = pipeline.run();
+
+    // Results of this shard for `merge`, also written when a file failed
+    if (sharded) {
+        double wall_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        if (!write_shard_results("gnuplot", shard, run, pipeline.results(), wall_seconds) && status == SUCCESS) {
+            status = ERROR_FILE_WRITE;
         }
     }
 
+    if (status != SUCCESS || !render) {
+        return status;
+    }
+
+    // Render everything that was exported
+    auto scripts = GnuplotRenderer::find_scripts(pipeline.output_dirs(), options.multiplot);
+    GnuplotRenderer renderer(gnuplot);
+    if (!renderer.render(scripts)) {
+        return ERROR_RENDER;
+    }
+
     return SUCCESS;
 }
@@ -1,24 +1,28 @@
 #ifndef MAIN_HPP
 #define MAIN_HPP
 
+#include <chrono>
+#include <cstdlib>
 #include <string>
 #include "../UPF_reader/UPF_reader.hpp"
 #include <iostream>
 #include <filesystem>
 #include "../output/gnuplot_exporter.hpp"
-
-// Program exit codes
-enum ExitCode {
-    SUCCESS = 0,
-    ERROR_INVALID_ARGS = 1,
-    ERROR_FILE_NOT_FOUND = 2,
-    ERROR_FILE_READ = 3,
-    ERROR_XML_PARSE = 4,
-    ERROR_FILE_WRITE = 5
-};
+#include "../output/gnuplot_renderer.hpp"
+#include "../pipeline/pipeline.hpp"
+#include "../diff/library_diff.hpp"
+#include "../shard/shard.hpp"
+#include "../cutoff/cutoff_estimator.hpp"
+#include "../realspace/projector_grid.hpp"
 
 // Utility functions
 bool file_exists(const std::string& filename);
 void print_usage(const char* program_name);
 
+// Commands
+int run_diff(int argc, char* argv[]);
+int run_merge(int argc, char* argv[]);
+int run_cutoff(int argc, char* argv[]);
+int run_grid(int argc, char* argv[]);
+
 #endif // MAIN_HPP
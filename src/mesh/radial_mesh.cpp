@@ -0,0 +1,327 @@
+#include "radial_mesh.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iterator>
+
+namespace {
+
+// Mesh point i of a closed form mesh
+double analytic_r(const MeshParameters& p, size_t i) {
+    switch (p.type) {
+        case MeshType::LINEAR: return p.r0 + i * p.dx;
+        case MeshType::LOGARITHMIC: return p.r0 * std::exp(i * p.dx);
+        case MeshType::SHIFTED_LOG: return p.a * std::expm1(i * p.dx);
+        default: return 0.0;
+    }
+}
+
+// dr/di at mesh point i of a closed form mesh
+double analytic_rab(const MeshParameters& p, size_t i) {
+    switch (p.type) {
+        case MeshType::LINEAR: return p.dx;
+        case MeshType::LOGARITHMIC: return analytic_r(p, i) * p.dx;
+        case MeshType::SHIFTED_LOG: return (analytic_r(p, i) + p.a) * p.dx;
+        default: return 0.0;
+    }
+}
+
+// Check a closed form against the tabulated values
+bool verify(const MeshParameters& p, const std::vector<double>& r, const std::vector<double>& rab) {
+    // Absolute slack for values printed as zero or with few digits
+    double scale = std::abs(r.back()) * RadialMesh::DETECTION_TOLERANCE;
+    for (size_t i = 0; i < r.size(); ++i) {
+        double tolerance = RadialMesh::DETECTION_TOLERANCE * std::abs(r[i]) + 1e-3 * scale;
+        if (std::abs(analytic_r(p, i) - r[i]) > tolerance) {
+            return false;
+        }
+    }
+
+    // PP_RAB is often printed with fewer digits than PP_R
+    if (rab.size() == r.size()) {
+        for (size_t i = 0; i < rab.size(); ++i) {
+            double expected = analytic_rab(p, i);
+            if (std::abs(expected - rab[i]) > 1e-4 * std::abs(expected) + 1e-10) {
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+} // namespace
+
+RadialMesh::RadialMesh(std::vector<double> r, std::vector<double> rab)
+    : r_(std::move(r)), rab_(std::move(rab)) {
+    fingerprint_ = compute_fingerprint(r_, rab_);
+    parameters_ = detect_parameters(r_, rab_);
+}
+
+double RadialMesh::rab(size_t i) const {
+    if (is_analytic()) {
+        return analytic_rab(parameters_, i);
+    }
+    if (rab_.size() == r_.size()) {
+        return rab_[i];
+    }
+
+    // No PP_RAB, finite differences of PP_R
+    size_t n = r_.size();
+    if (n < 2) {
+        return 0.0;
+    }
+    if (i == 0) {
+        return r_[1] - r_[0];
+    }
+    if (i == n - 1) {
+        return r_[n - 1] - r_[n - 2];
+    }
+    return 0.5 * (r_[i + 1] - r_[i - 1]);
+}
+
+size_t RadialMesh::interval(double x) const {
+    size_t n = r_.size();
+    if (n < 2 || x <= r_.front()) {
+        return 0;
+    }
+    if (x >= r_.back()) {
+        return n - 2;
+    }
+
+    size_t i = 0;
+    const MeshParameters& p = parameters_;
+    switch (p.type) {
+        case MeshType::LINEAR:
+            i = static_cast<size_t>((x - p.r0) / p.dx);
+            break;
+        case MeshType::LOGARITHMIC:
+            i = static_cast<size_t>(std::log(x / p.r0) / p.dx);
+            break;
+        case MeshType::SHIFTED_LOG:
+            i = static_cast<size_t>(std::log1p(x / p.a) / p.dx);
+            break;
+        default:
+            return std::upper_bound(r_.begin(), r_.end(), x) - r_.begin() - 1;
+    }
+
+    // The closed form can be off by one through rounding, fix it with the table
+    i = std::min(i, n - 2);
+    while (i > 0 && r_[i] > x) {
+        --i;
+    }
+    while (i < n - 2 && r_[i + 1] <= x) {
+        ++i;
+    }
+    return i;
+}
+
+const std::vector<double>& RadialMesh::integration_weights() const {
+    std::call_once(weights_once_, [this]() {
+        size_t n = r_.size();
+        integration_weights_.assign(n, 0.0);
+        if (n < 2) {
+            return;
+        }
+
+        // dr/di, closed form, from PP_RAB or from finite differences of PP_R
+        std::vector<double> dr(n);
+        for (size_t i = 0; i < n; ++i) {
+            dr[i] = rab(i);
+        }
+
+        // Trapezoid rule when there are too few points for Simpson
+        if (n < 3) {
+            integration_weights_[0] = 0.5 * dr[0];
+            integration_weights_[1] = 0.5 * dr[1];
+            return;
+        }
+
+        // Simpson's rule over an even number of intervals,
+        // a trapezoid closes the last interval of an even sized mesh
+        size_t n_simpson = (n % 2 == 1) ? n : n - 1;
+        for (size_t i = 0; i + 2 < n_simpson; i += 2) {
+            integration_weights_[i] += dr[i] / 3.0;
+            integration_weights_[i + 1] += 4.0 * dr[i + 1] / 3.0;
+            integration_weights_[i + 2] += dr[i + 2] / 3.0;
+        }
+        if (n_simpson != n) {
+            integration_weights_[n - 2] += 0.5 * dr[n - 2];
+            integration_weights_[n - 1] += 0.5 * dr[n - 1];
+        }
+    });
+    return integration_weights_;
+}
+
+std::shared_ptr<const MeshInterpolation> RadialMesh::interpolation_to(const RadialMesh& target) const {
+    std::lock_guard<std::mutex> lock(interpolation_mutex_);
+    auto it = interpolations_.find(target.fingerprint());
+    if (it != interpolations_.end()) {
+        return it->second;
+    }
+
+    auto interpolation = std::make_shared<const MeshInterpolation>(interpolation_to(target.r()));
+    interpolations_.emplace(target.fingerprint(), interpolation);
+    return interpolation;
+}
+
+MeshInterpolation RadialMesh::interpolation_to(const std::vector<double>& points) const {
+    MeshInterpolation interpolation;
+    interpolation.index.resize(points.size());
+    interpolation.weight.resize(points.size());
+
+    size_t n = r_.size();
+    for (size_t k = 0; k < points.size(); ++k) {
+        double x = points[k];
+        if (n < 2 || x <= r_.front()) {
+            interpolation.index[k] = 0;
+            interpolation.weight[k] = 0.0;
+            continue;
+        }
+        if (x >= r_.back()) {
+            interpolation.index[k] = n - 2;
+            interpolation.weight[k] = 1.0;
+            continue;
+        }
+
+        // Interval r_[i] <= x < r_[i + 1]
+        size_t i = interval(x);
+        interpolation.index[k] = i;
+        interpolation.weight[k] = (x - r_[i]) / (r_[i + 1] - r_[i]);
+    }
+
+    return interpolation;
+}
+
+uint64_t RadialMesh::compute_fingerprint(const std::vector<double>& r, const std::vector<double>& rab) {
+    // FNV-1a over the raw bytes of both arrays
+    uint64_t hash = 14695981039346656037ull;
+    auto mix = [&hash](const std::vector<double>& values) {
+        for (double value : values) {
+            unsigned char bytes[sizeof(double)];
+            std::memcpy(bytes, &value, sizeof(double));
+            for (unsigned char byte : bytes) {
+                hash ^= byte;
+                hash *= 1099511628211ull;
+            }
+        }
+        hash ^= values.size();
+        hash *= 1099511628211ull;
+    };
+    mix(r);
+    mix(rab);
+    return hash;
+}
+
+MeshParameters RadialMesh::detect_parameters(const std::vector<double>& r, const std::vector<double>& rab) {
+    MeshParameters p;
+    size_t n = r.size();
+    if (n < 3) {
+        return p;
+    }
+
+    // Uniform grid
+    MeshParameters linear;
+    linear.type = MeshType::LINEAR;
+    linear.r0 = r[0];
+    linear.dx = (r[n - 1] - r[0]) / (n - 1);
+    if (linear.dx > 0.0 && verify(linear, r, rab)) {
+        return linear;
+    }
+
+    // Quantum ESPRESSO logarithmic grid, starts above zero
+    if (r[0] > 0.0 && r[1] > r[0]) {
+        MeshParameters log_mesh;
+        log_mesh.type = MeshType::LOGARITHMIC;
+        log_mesh.r0 = r[0];
+        log_mesh.dx = std::log(r[n - 1] / r[0]) / (n - 1);
+        if (verify(log_mesh, r, rab)) {
+            return log_mesh;
+        }
+    }
+
+    // Shifted exponential grid, starts at zero and r_2/r_1 = exp(dx) + 1 > 2
+    if (r[0] == 0.0 && r[1] > 0.0 && r[2] / r[1] > 2.0) {
+        // (exp(m*dx) - 1)/(exp(k*dx) - 1) grows with dx, bisect on far points
+        size_t m = n - 1;
+        size_t k = m / 2;
+        double ratio = r[m] / r[k];
+        double lo = 0.0;
+        double hi = 2.0 * std::log(r[2] / r[1] - 1.0) + 1.0;
+        for (int iter = 0; iter < 200; ++iter) {
+            double mid = 0.5 * (lo + hi);
+            if (std::expm1(m * mid) / std::expm1(k * mid) < ratio) {
+                lo = mid;
+            } else {
+                hi = mid;
+            }
+        }
+
+        MeshParameters shifted;
+        shifted.type = MeshType::SHIFTED_LOG;
+        shifted.dx = 0.5 * (lo + hi);
+        shifted.a = r[m] / std::expm1(m * shifted.dx);
+        if (shifted.dx > 0.0 && verify(shifted, r, rab)) {
+            return shifted;
+        }
+    }
+
+    return p;
+}
+
+MeshRegistry& MeshRegistry::instance() {
+    static MeshRegistry registry;
+    return registry;
+}
+
+std::shared_ptr<const RadialMesh> MeshRegistry::find(uint64_t fingerprint, const std::vector<double>& r,
+                                                     const std::vector<double>& rab) {
+    // Compare the values too, a fingerprint match alone is not proof
+    auto range = meshes_.equal_range(fingerprint);
+    for (auto it = range.first; it != range.second;) {
+        auto mesh = it->second.lock();
+        if (!mesh) {
+            it = meshes_.erase(it);
+            continue;
+        }
+        if (mesh->r() == r && mesh->rab() == rab) {
+            return mesh;
+        }
+        ++it;
+    }
+    return nullptr;
+}
+
+std::shared_ptr<const RadialMesh> MeshRegistry::intern(std::vector<double> r, std::vector<double> rab) {
+    uint64_t fingerprint = RadialMesh::compute_fingerprint(r, rab);
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (auto mesh = find(fingerprint, r, rab)) {
+            return mesh;
+        }
+    }
+
+    // Type detection is the expensive part, keep it out of the lock
+    auto mesh = std::make_shared<const RadialMesh>(std::move(r), std::move(rab));
+
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    // Another thread may have interned the same mesh meanwhile
+    if (auto existing = find(fingerprint, mesh->r(), mesh->rab())) {
+        return existing;
+    }
+
+    // Drop the entries of freed meshes with other fingerprints
+    for (auto it = meshes_.begin(); it != meshes_.end();) {
+        it = it->second.expired() ? meshes_.erase(it) : std::next(it);
+    }
+    meshes_.emplace(fingerprint, mesh);
+    fingerprints_.insert(fingerprint);
+    return mesh;
+}
+
+size_t MeshRegistry::size() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return fingerprints_.size();
+}
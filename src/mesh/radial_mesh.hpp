@@ -0,0 +1,113 @@
+#ifndef RADIAL_MESH_HPP
+#define RADIAL_MESH_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <vector>
+
+// Linear interpolation from one mesh onto a set of points:
+// f(x_k) = (1 - weight[k]) * f[index[k]] + weight[k] * f[index[k] + 1]
+struct MeshInterpolation {
+    std::vector<size_t> index;
+    std::vector<double> weight;
+};
+
+// Closed form of a radial mesh, detected from the tabulated values
+enum class MeshType {
+    TABULATED,    // no closed form found, use the PP_R/PP_RAB tables
+    LINEAR,       // r_i = r0 + i*dx,               rab_i = dx
+    LOGARITHMIC,  // r_i = exp(xmin + i*dx)/zmesh,  rab_i = r_i*dx
+    SHIFTED_LOG   // r_i = a*(exp(i*dx) - 1),       rab_i = (r_i + a)*dx
+};
+
+struct MeshParameters {
+    MeshType type = MeshType::TABULATED;
+    double r0 = 0.0;  // first point (LINEAR), exp(xmin)/zmesh (LOGARITHMIC)
+    double dx = 0.0;  // uniform step in the mesh variable
+    double a = 0.0;   // prefactor (SHIFTED_LOG)
+};
+
+// Immutable radial mesh (PP_R and PP_RAB), shared between all
+// pseudopotentials that use the same grid. Quantities derived from the
+// mesh are computed on first use and cached with it.
+class RadialMesh {
+public:
+    RadialMesh(std::vector<double> r, std::vector<double> rab);
+
+    const std::vector<double>& r() const { return r_; }
+    const std::vector<double>& rab() const { return rab_; }
+    size_t size() const { return r_.size(); }
+    uint64_t fingerprint() const { return fingerprint_; }
+
+    // Detected closed form, TABULATED if the mesh has none
+    const MeshParameters& parameters() const { return parameters_; }
+    bool is_analytic() const { return parameters_.type != MeshType::TABULATED; }
+
+    // dr/di at point i, closed form for analytic meshes
+    double rab(size_t i) const;
+
+    // Interval i with r_i <= x < r_{i+1}, clamped to [0, size() - 2].
+    // O(1) for analytic meshes, binary search otherwise.
+    size_t interval(double x) const;
+
+    // Relative tolerance used when verifying a closed form against the table
+    static constexpr double DETECTION_TOLERANCE = 1e-6;
+
+    // Simpson weights w_i with integral f(r) dr ~ sum_i w_i f_i
+    const std::vector<double>& integration_weights() const;
+
+    // Interpolation of functions on this mesh onto the points of another mesh
+    std::shared_ptr<const MeshInterpolation> interpolation_to(const RadialMesh& target) const;
+
+    // Interpolation onto arbitrary points (not cached)
+    MeshInterpolation interpolation_to(const std::vector<double>& points) const;
+
+    // Hash of the mesh values, equal meshes have equal fingerprints
+    static uint64_t compute_fingerprint(const std::vector<double>& r, const std::vector<double>& rab);
+
+    // Find the closed form of a tabulated mesh, TABULATED if none fits
+    static MeshParameters detect_parameters(const std::vector<double>& r, const std::vector<double>& rab);
+
+private:
+    std::vector<double> r_;
+    std::vector<double> rab_;
+    uint64_t fingerprint_;
+    MeshParameters parameters_;
+
+    mutable std::once_flag weights_once_;
+    mutable std::vector<double> integration_weights_;
+
+    mutable std::mutex interpolation_mutex_;
+    mutable std::map<uint64_t, std::shared_ptr<const MeshInterpolation>> interpolations_;
+};
+
+// Process-wide registry of radial meshes. intern() returns the existing
+// instance when an identical mesh is still in use. The registry only holds
+// weak references, a mesh is freed with the last file that uses it.
+class MeshRegistry {
+public:
+    static MeshRegistry& instance();
+
+    std::shared_ptr<const RadialMesh> intern(std::vector<double> r, std::vector<double> rab);
+
+    // Number of distinct meshes loaded so far (by fingerprint)
+    size_t size() const;
+
+private:
+    MeshRegistry() = default;
+
+    // Live mesh equal to r/rab, drops expired entries of the fingerprint.
+    // Called with mutex_ held.
+    std::shared_ptr<const RadialMesh> find(uint64_t fingerprint, const std::vector<double>& r,
+                                           const std::vector<double>& rab);
+
+    mutable std::mutex mutex_;
+    std::multimap<uint64_t, std::weak_ptr<const RadialMesh>> meshes_;
+    std::set<uint64_t> fingerprints_;  // every mesh ever interned
+};
+
+#endif // RADIAL_MESH_HPP
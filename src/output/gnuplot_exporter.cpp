@@ -2,9 +2,14 @@
 #include <fstream>
 #include <iostream>
 #include <sstream>
+#include <cmath>
 
 GnuplotExporter::GnuplotExporter(const std::filesystem::path& output_dir, const std::string& element)
-    : output_dir_(output_dir) {
+    : GnuplotExporter(output_dir, element, snapshot_globals()) {
+}
+
+GnuplotExporter::GnuplotExporter(const std::filesystem::path& output_dir, const std::string& element, UPFData data)
+    : output_dir_(output_dir), data_(std::move(data)) {
     // Trim whitespace from element name
     element_name_ = element;
     auto start = element_name_.find_first_not_of(" \t\n\r");
@@ -22,7 +27,7 @@ bool GnuplotExporter::export_local_potential() const {
     auto data_file = output_dir_ / (element_name_ + "_local_potential.dat");
     auto script_file = output_dir_ / "plot_local_potential.gp";
     
-    if (!write_data_file(data_file.string(), g_r_mesh, g_local_potential)) {
+    if (!write_data_file(data_file.string(), data_.mesh->r(), data_.local_potential)) {
         return false;
     }
 
@@ -42,11 +47,11 @@ bool GnuplotExporter::export_nonlocal_potentials() const {
     auto script_file = output_dir_ / "plot_nonlocal_potentials.gp";
     
     std::map<std::string, std::vector<double>> y_data_map;
-    for (const auto& [l, data] : g_nonlocal_potentials) {
+    for (const auto& [l, data] : data_.nonlocal_potentials) {
         y_data_map[std::to_string(l)] = data;
     }
 
-    if (!write_multi_data_file(data_file.string(), g_r_mesh, y_data_map)) {
+    if (!write_multi_data_file(data_file.string(), data_.mesh->r(), y_data_map)) {
         return false;
     }
 
@@ -54,7 +59,7 @@ bool GnuplotExporter::export_nonlocal_potentials() const {
     plot_cmd << "plot ";
     bool first = true;
     int i = 0;
-    for (const auto& [l, _] : g_nonlocal_potentials) {
+    for (const auto& [l, _] : data_.nonlocal_potentials) {
         if (!first) plot_cmd << ", ";
         plot_cmd << "'" << data_file.filename().string() << "' using 1:" 
                 << (i+2)
@@ -72,11 +77,11 @@ bool GnuplotExporter::export_projectors() const {
     auto script_file = output_dir_ / "plot_projectors.gp";
     
     std::map<std::string, std::vector<double>> y_data_map;
-    for (const auto& [l, data] : g_projectors) {
+    for (const auto& [l, data] : data_.projectors) {
         y_data_map[std::to_string(l)] = data;
     }
 
-    if (!write_multi_data_file(data_file.string(), g_r_mesh, y_data_map)) {
+    if (!write_multi_data_file(data_file.string(), data_.mesh->r(), y_data_map)) {
         return false;
     }
 
@@ -84,7 +89,7 @@ bool GnuplotExporter::export_projectors() const {
     plot_cmd << "plot ";
     bool first = true;
     int i = 0;
-    for (const auto& [l, _] : g_projectors) {
+    for (const auto& [l, _] : data_.projectors) {
         if (!first) plot_cmd << ", ";
         plot_cmd << "'" << data_file.filename().string() << "' using 1:" 
                 << (i+2)
@@ -98,7 +103,7 @@ bool GnuplotExporter::export_projectors() const {
 }
 
 bool GnuplotExporter::export_orbital_values() const {
-    for (const auto& [type, orbitals] : g_orbitals) {
+    for (const auto& [type, orbitals] : data_.orbitals) {
         // Get orbital type name (s, p, d, ...)
         std::string orbital_type;
         switch(type) {
@@ -119,7 +124,7 @@ bool GnuplotExporter::export_orbital_values() const {
             y_data_map[std::to_string(i++)] = orb.values;
         }
 
-        if (!write_multi_data_file(data_file.string(), g_r_mesh, y_data_map)) {
+        if (!write_multi_data_file(data_file.string(), data_.mesh->r(), y_data_map)) {
             return false;
         }
 
@@ -151,11 +156,11 @@ bool GnuplotExporter::export_total_potentials() const {
     auto script_file = output_dir_ / "plot_total_potentials.gp";
     
     std::map<std::string, std::vector<double>> y_data_map;
-    for (const auto& [l, data] : g_total_potentials) {
+    for (const auto& [l, data] : data_.total_potentials) {
         y_data_map[std::to_string(l)] = data;
     }
 
-    if (!write_multi_data_file(data_file.string(), g_r_mesh, y_data_map)) {
+    if (!write_multi_data_file(data_file.string(), data_.mesh->r(), y_data_map)) {
         return false;
     }
 
@@ -163,7 +168,7 @@ bool GnuplotExporter::export_total_potentials() const {
     plot_cmd << "plot ";
     bool first = true;
     int i = 0;
-    for (const auto& [l, _] : g_total_potentials) {
+    for (const auto& [l, _] : data_.total_potentials) {
         if (!first) plot_cmd << ", ";
         plot_cmd << "'" << data_file.filename().string() << "' using 1:" 
                 << (i+2)
@@ -176,79 +181,232 @@ bool GnuplotExporter::export_total_potentials() const {
     return write_gnuplot_script(script_file.string(), title, plot_cmd.str());
 }
 
+bool GnuplotExporter::export_charge_density() const {
+    const ChargeDensity& density = data_.density;
+    if (density.rho_atom.empty() && density.nlcc.empty()) {
+        return true; // Nothing to export
+    }
+
+    auto data_file = output_dir_ / (element_name_ + "_charge_density.dat");
+    auto script_file = output_dir_ / "plot_charge_density.gp";
+
+    // Core charge as 4*pi*r^2*rho_core(r), comparable with PP_RHOATOM
+    const std::vector<double>& r = data_.mesh->r();
+    std::map<std::string, std::vector<double>> y_data_map;
+    if (!density.rho_atom.empty()) {
+        y_data_map["rho_atom"] = density.rho_atom;
+    }
+    if (!density.nlcc.empty()) {
+        std::vector<double> core(density.nlcc.size());
+        for (size_t i = 0; i < core.size() && i < r.size(); ++i) {
+            core[i] = 4.0 * M_PI * r[i] * r[i] * density.nlcc[i];
+        }
+        y_data_map["rho_core"] = std::move(core);
+    }
+
+    if (!write_multi_data_file(data_file.string(), r, y_data_map)) {
+        return false;
+    }
+
+    std::stringstream plot_cmd;
+    plot_cmd << "plot ";
+    bool first = true;
+    int i = 0;
+    for (const auto& [label, _] : y_data_map) {
+        if (!first) plot_cmd << ", ";
+        plot_cmd << "'" << data_file.filename().string() << "' using 1:"
+                << (i+2)
+                << " with lines title '4{/Symbol p}r^{2}{/Symbol r}_{"
+                << (label == "rho_atom" ? "atom" : "core") << "}(r)'";
+        first = false;
+        i++;
+    }
+
+    std::string title = "Charge Density for " + element_name_;
+    return write_gnuplot_script(script_file.string(), title, plot_cmd.str(), "4{/Symbol p}r^{2}{/Symbol r}(r) (e/a_{0})");
+}
+
+bool GnuplotExporter::export_hartree_potential() const {
+    const ChargeDensity& density = data_.density;
+    if (density.hartree.empty() && density.core_hartree.empty()) {
+        return true; // Nothing to export
+    }
+
+    auto data_file = output_dir_ / (element_name_ + "_hartree_potential.dat");
+    auto script_file = output_dir_ / "plot_hartree_potential.gp";
+
+    std::map<std::string, std::vector<double>> y_data_map;
+    if (!density.hartree.empty()) {
+        y_data_map["atom"] = density.hartree;
+    }
+    if (!density.core_hartree.empty()) {
+        y_data_map["core"] = density.core_hartree;
+    }
+
+    if (!write_multi_data_file(data_file.string(), data_.mesh->r(), y_data_map)) {
+        return false;
+    }
+
+    std::stringstream plot_cmd;
+    plot_cmd << "plot ";
+    bool first = true;
+    int i = 0;
+    for (const auto& [label, _] : y_data_map) {
+        if (!first) plot_cmd << ", ";
+        plot_cmd << "'" << data_file.filename().string() << "' using 1:"
+                << (i+2)
+                << " with lines title 'V_{H," << label << "}(r)'";
+        first = false;
+        i++;
+    }
+
+    std::string title = "Hartree Potential for " + element_name_;
+    return write_gnuplot_script(script_file.string(), title, plot_cmd.str());
+}
+
 bool GnuplotExporter::export_all() const {
-    if (!g_upf_data_valid) {
+    if (!data_.valid) {
         std::cerr << "Error: No valid UPF data available for plotting\n";
         return false;
     }
 
-    return export_local_potential() &&
-           export_nonlocal_potentials() &&
-           export_projectors() &&
-           export_orbital_values() &&
-           export_total_potentials();
+    plots_.clear();
+    if (!(export_local_potential() &&
+          export_nonlocal_potentials() &&
+          export_projectors() &&
+          export_orbital_values() &&
+          export_total_potentials() &&
+          export_charge_density() &&
+          export_hartree_potential())) {
+        return false;
+    }
+
+    if (options_.multiplot) {
+        return write_multiplot_script();
+    }
+
+    return true;
+}
+
+void GnuplotExporter::set_options(const ExportOptions& options) {
+    options_ = options;
 }
 
 bool GnuplotExporter::write_gnuplot_script(const std::string& filename,
                                          const std::string& title,
-                                         const std::string& plot_command) const {
+                                         const std::string& plot_command,
+                                         const std::string& ylabel) const {
     std::ofstream script(filename);
     if (!script) {
         std::cerr << "Failed to create gnuplot script file: " << filename << "\n";
         return false;
     }
 
-    // Common settings for both linear and log scale
-    auto write_common_settings = [&script](const std::string& title, bool logscale) {
-        script << "set title '" << title << (logscale ? " (log scale)" : "") << "' enhanced\n"
-               << "set xlabel 'r (a_{0})" << (logscale ? " [log]" : "") << "' enhanced\n"  // Bohr radius
-               << "set ylabel 'V(r) (Ry)' enhanced\n"
-               << "set grid\n";
-        if (logscale) {
-            script << "set logscale x\n";
-        } else {
-            script << "unset logscale x\n";
-        }
-    };
+    // Remember the plot for the combined multiplot script
+    plots_.push_back({title, plot_command, ylabel});
 
     // Helper for writing plots in different formats
-    auto write_plot = [&](const std::string& terminal, const std::string& suffix = "") {
+    auto write_plot = [&](const std::string& terminal, const std::string& suffix, const std::string& extension) {
         // Linear scale plot
-        write_common_settings(title, false);
+        write_plot_settings(script, title, false, ylabel);
         script << "set terminal " << terminal << "\n";
         if (!suffix.empty()) {
             script << "set output '" << std::filesystem::path(filename).stem().string() 
-                   << suffix << ".eps'\n";
+                   << suffix << extension << "'\n";
         }
         script << plot_command << "\n\n";
 
         // Log scale plot
-        write_common_settings(title, true);
+        write_plot_settings(script, title, true, ylabel);
         script << "set terminal " << terminal << "\n";
         if (!suffix.empty()) {
             script << "set output '" << std::filesystem::path(filename).stem().string() 
-                   << suffix << "_log.eps'\n";
+                   << suffix << "_log" << extension << "'\n";
         }
         script << plot_command << "\n\n";
     };
 
+    write_terminals(script, options_.render_mode, write_plot);
+
+    return true;
+}
+
+void GnuplotExporter::write_terminals(std::ostream& script, RenderMode render_mode, const TerminalPass& plot) {
+    if (render_mode == RenderMode::HEADLESS) {
+        // File terminals only, the script runs unattended
+        plot("pngcairo enhanced size 1024,768", "_color", ".png");
+        plot("pdfcairo enhanced color", "_color", ".pdf");
+        plot("postscript eps enhanced color", "_color", ".eps");
+        script << "set output\n";
+        return;
+    }
+
     // X11 terminal (interactive)
-    write_plot("x11");
+    plot("x11", "", ".eps");
     script << "pause -1 'Press any key to continue'\n\n";
 
     // Color PostScript output
-    write_plot("postscript enhanced color", "_color");
+    plot("postscript enhanced color", "_color", ".eps");
 
     // Monochrome PostScript output
-    write_plot("postscript enhanced monochrome", "_mono");
+    plot("postscript enhanced monochrome", "_mono", ".eps");
 
     // Reset terminal to interactive mode
     script << "set terminal x11\n"
            << "set output\n";
+}
+
+bool GnuplotExporter::write_multiplot_script() const {
+    auto script_file = output_dir_ / GnuplotExporter::MULTIPLOT_SCRIPT;
+    std::ofstream script(script_file);
+    if (!script) {
+        std::cerr << "Failed to create gnuplot script file: " << script_file.string() << "\n";
+        return false;
+    }
+
+    // One page with a row per plot group, linear scale left and log scale right
+    size_t rows = plots_.size();
+    auto write_page = [&](const std::string& terminal, const std::string& extension) {
+        script << "set terminal " << terminal << "\n"
+               << "set output '" << element_name_ << "_all" << extension << "'\n"
+               << "set multiplot layout " << rows << ",2 title '" << element_name_ << "'\n";
+        for (const auto& plot : plots_) {
+            write_plot_settings(script, plot.title, false, plot.ylabel);
+            script << plot.plot_command << "\n";
+            write_plot_settings(script, plot.title, true, plot.ylabel);
+            script << plot.plot_command << "\n";
+        }
+        script << "unset multiplot\n"
+               << "set output\n\n";
+    };
+
+    write_page("pngcairo enhanced size 1600," + std::to_string(400 * rows), ".png");
+    write_page("pdfcairo enhanced color size 16cm," + std::to_string(5 * rows) + "cm", ".pdf");
+    write_page("postscript eps enhanced color size 16cm," + std::to_string(5 * rows) + "cm", ".eps");
 
     return true;
 }
 
+void GnuplotExporter::write_plot_settings(std::ostream& script, const std::string& title, bool logscale,
+                                          const std::string& ylabel) {
+    // Common settings for both linear and log scale
+    write_axes(script, title + (logscale ? " (log scale)" : ""),
+               std::string("r (a_{0})") + (logscale ? " [log]" : ""), ylabel);  // Bohr radius
+    if (logscale) {
+        script << "set logscale x\n";
+    } else {
+        script << "unset logscale x\n";
+    }
+}
+
+void GnuplotExporter::write_axes(std::ostream& script, const std::string& title, const std::string& xlabel,
+                                 const std::string& ylabel) {
+    script << "set title '" << title << "' enhanced\n"
+           << "set xlabel '" << xlabel << "' enhanced\n"
+           << "set ylabel '" << ylabel << "' enhanced\n"
+           << "set grid\n";
+}
+
 bool GnuplotExporter::write_data_file(const std::string& filename,
                                     const std::vector<double>& x_data,
                                     const std::vector<double>& y_data) const {
@@ -3,31 +3,82 @@
 
 #include <string>
 #include <filesystem>
+#include <functional>
+#include <ostream>
 #include "../globals/globals.hpp"
 #include "../UPF_reader/UPF_reader.hpp"
 
+// How the generated gnuplot scripts render their plots
+enum class RenderMode {
+    INTERACTIVE,  // x11 window, then color and mono PostScript
+    HEADLESS      // no window or pause, PNG, PDF and EPS files only
+};
+
+struct ExportOptions {
+    RenderMode render_mode = RenderMode::INTERACTIVE;
+    bool multiplot = false;  // also write one script with all plots of the element
+};
+
 class GnuplotExporter {
 public:
+    // Name of the combined script written when ExportOptions::multiplot is set
+    static constexpr const char* MULTIPLOT_SCRIPT = "plot_all.gp";
+
     explicit GnuplotExporter(const std::filesystem::path& output_dir, const std::string& element = "");
 
+    // Export from a snapshot instead of the current global data
+    GnuplotExporter(const std::filesystem::path& output_dir, const std::string& element, UPFData data);
+
     // Export functions for different data types
     bool export_local_potential() const;
     bool export_nonlocal_potentials() const;
     bool export_projectors() const;
     bool export_orbital_values() const;
     bool export_total_potentials() const;
+    bool export_charge_density() const;
+    bool export_hartree_potential() const;
     
     // Export all data at once
     bool export_all() const;
 
+    void set_options(const ExportOptions& options);
+
+    // Title, axis labels (enhanced text) and grid of one plot
+    static void write_axes(std::ostream& script, const std::string& title, const std::string& xlabel,
+                           const std::string& ylabel);
+
+    // Emit one pass per terminal of the render mode, with the pause and the
+    // terminal reset between them. plot(terminal, suffix, extension) writes
+    // the settings and plot commands of one pass, the output file is
+    // <name><suffix><extension>, no file when suffix is empty (x11 window).
+    using TerminalPass = std::function<void(const std::string& terminal, const std::string& suffix,
+                                            const std::string& extension)>;
+    static void write_terminals(std::ostream& script, RenderMode render_mode, const TerminalPass& plot);
+
 private:
     std::filesystem::path output_dir_;
     std::string element_name_;
+    UPFData data_;
+    ExportOptions options_;
+
+    // Every script written, for the multiplot script
+    struct Plot {
+        std::string title;
+        std::string plot_command;
+        std::string ylabel;
+    };
+    mutable std::vector<Plot> plots_;
     
     // Helper functions
     bool write_gnuplot_script(const std::string& filename,
                              const std::string& title,
-                             const std::string& plot_command) const;
+                             const std::string& plot_command,
+                             const std::string& ylabel = "V(r) (Ry)") const;
+
+    bool write_multiplot_script() const;
+
+    static void write_plot_settings(std::ostream& script, const std::string& title, bool logscale,
+                                    const std::string& ylabel);
     
     bool write_data_file(const std::string& filename,
                         const std::vector<double>& x_data,
@@ -0,0 +1,91 @@
+#include "gnuplot_renderer.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <iostream>
+#include "gnuplot_exporter.hpp"
+#include "../parallel/parallel.hpp"
+
+GnuplotRenderer::GnuplotRenderer(const std::string& gnuplot)
+    : gnuplot_(gnuplot) {
+}
+
+bool GnuplotRenderer::render(const std::vector<std::filesystem::path>& scripts) const {
+    if (!std::system(nullptr)) {
+        std::cerr << "Error: No command processor available to run gnuplot\n";
+        return false;
+    }
+
+    std::atomic<size_t> failed{0};
+    parallel_for(scripts.size(), [&](size_t i) {
+        if (!render_script(scripts[i])) {
+            failed++;
+        }
+    });
+
+    if (failed > 0) {
+        std::cerr << "Error: " << failed << " of " << scripts.size() << " gnuplot scripts failed\n";
+        return false;
+    }
+
+    return true;
+}
+
+std::vector<std::filesystem::path> GnuplotRenderer::find_scripts(const std::vector<std::filesystem::path>& dirs,
+                                                                 bool multiplot) {
+    std::vector<std::filesystem::path> scripts;
+    for (const auto& dir : dirs) {
+        if (multiplot) {
+            auto script = dir / GnuplotExporter::MULTIPLOT_SCRIPT;
+            if (std::filesystem::exists(script)) {
+                scripts.push_back(script);
+            }
+            continue;
+        }
+
+        std::error_code ec;
+        for (const auto& entry : std::filesystem::directory_iterator(dir, ec)) {
+            if (entry.path().extension() == ".gp" &&
+                entry.path().filename() != GnuplotExporter::MULTIPLOT_SCRIPT) {
+                scripts.push_back(entry.path());
+            }
+        }
+    }
+
+    std::sort(scripts.begin(), scripts.end());
+    return scripts;
+}
+
+bool GnuplotRenderer::render_script(const std::filesystem::path& script) const {
+    // Run inside the script directory, gnuplot output is only kept on failure
+    std::filesystem::path dir = script.parent_path();
+    if (dir.empty()) {
+        dir = ".";
+    }
+    std::string command = "cd " + shell_quote(dir.string()) + " && " +
+                          shell_quote(gnuplot_) + " " + shell_quote(script.filename().string()) +
+                          " > " + shell_quote(script.filename().string() + ".log") + " 2>&1";
+
+    int status = std::system(command.c_str());
+    if (status != 0) {
+        std::cerr << "Error: gnuplot failed on '" << script.string() << "' (see "
+                  << script.string() << ".log)\n";
+        return false;
+    }
+
+    std::error_code ec;
+    std::filesystem::remove(script.string() + ".log", ec);
+    return true;
+}
+
+std::string GnuplotRenderer::shell_quote(const std::string& text) {
+    std::string quoted = "'";
+    for (char c : text) {
+        if (c == '\'') {
+            quoted += "'\\''";
+        } else {
+            quoted += c;
+        }
+    }
+    return quoted + "'";
+}
@@ -0,0 +1,30 @@
+#ifndef GNUPLOT_RENDERER_HPP
+#define GNUPLOT_RENDERER_HPP
+
+#include <string>
+#include <vector>
+#include <filesystem>
+
+// Runs the local gnuplot binary on generated scripts, several at a time.
+// Scripts must be headless (see RenderMode::HEADLESS), each one is run in
+// its own directory so the relative data file names resolve.
+class GnuplotRenderer {
+public:
+    explicit GnuplotRenderer(const std::string& gnuplot = "gnuplot");
+
+    // Render all scripts in parallel, returns false if any of them failed
+    bool render(const std::vector<std::filesystem::path>& scripts) const;
+
+    // Scripts in the given output directories. With multiplot only the
+    // combined per-element script is returned.
+    static std::vector<std::filesystem::path> find_scripts(const std::vector<std::filesystem::path>& dirs,
+                                                           bool multiplot);
+
+private:
+    std::string gnuplot_;
+
+    bool render_script(const std::filesystem::path& script) const;
+    static std::string shell_quote(const std::string& text);
+};
+
+#endif // GNUPLOT_RENDERER_HPP
@@ -0,0 +1,43 @@
+#ifndef PARALLEL_HPP
+#define PARALLEL_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include "thread_pool.hpp"
+
+// Number of threads taking part in parallel loops (pool workers + caller)
+inline size_t worker_count() {
+    return ThreadPool::instance().size() + 1;
+}
+
+// Call fn(i) for every i in [0, n) on the shared ThreadPool. Iterations are
+// handed out one at a time from a shared counter, so blocks of very
+// different cost balance themselves. fn must be safe to call concurrently
+// for different i. Can be nested, the waiting thread helps with the work.
+template <typename Function>
+void parallel_for(size_t n, Function fn) {
+    size_t n_tasks = std::min(worker_count(), n);
+    if (n_tasks <= 1) {
+        for (size_t i = 0; i < n; ++i) {
+            fn(i);
+        }
+        return;
+    }
+
+    std::atomic<size_t> next{0};
+    auto worker = [&]() {
+        for (size_t i = next++; i < n; i = next++) {
+            fn(i);
+        }
+    };
+
+    TaskGroup group;
+    for (size_t t = 1; t < n_tasks; ++t) {
+        group.run(worker);
+    }
+    worker();
+    group.wait();
+}
+
+#endif // PARALLEL_HPP
@@ -0,0 +1,178 @@
+#include "thread_pool.hpp"
+
+namespace {
+
+// Index of the pool worker running on this thread, -1 for other threads
+thread_local int t_worker_index = -1;
+thread_local const ThreadPool* t_worker_pool = nullptr;
+
+} // namespace
+
+ThreadPool& ThreadPool::instance() {
+    static ThreadPool pool(std::thread::hardware_concurrency() > 1 ? std::thread::hardware_concurrency() - 1 : 0);
+    return pool;
+}
+
+ThreadPool::ThreadPool(size_t n_workers) {
+    // At least one queue, so tasks can be queued even without workers
+    size_t n_queues = n_workers > 0 ? n_workers : 1;
+    for (size_t i = 0; i < n_queues; ++i) {
+        queues_.push_back(std::make_unique<TaskQueue>());
+    }
+
+    for (size_t i = 0; i < n_workers; ++i) {
+        threads_.emplace_back([this, i] { worker_loop(i); });
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(sleep_mutex_);
+        stop_ = true;
+    }
+    wake_.notify_all();
+    for (auto& thread : threads_) {
+        thread.join();
+    }
+}
+
+void ThreadPool::submit(std::function<void()> task) {
+    // Workers keep their own tasks local, others spread them round robin
+    size_t index = (t_worker_pool == this && t_worker_index >= 0)
+                       ? static_cast<size_t>(t_worker_index)
+                       : next_queue_++ % queues_.size();
+
+    // Count the task before publishing it, a thief decrements pending_
+    // as soon as it takes the task and must never see it wrap below zero
+    {
+        std::lock_guard<std::mutex> lock(sleep_mutex_);
+        pending_++;
+    }
+    {
+        std::lock_guard<std::mutex> lock(queues_[index]->mutex);
+        queues_[index]->tasks.push_back(std::move(task));
+    }
+    wake_.notify_one();
+}
+
+bool ThreadPool::try_run_one() {
+    size_t index = (t_worker_pool == this && t_worker_index >= 0)
+                       ? static_cast<size_t>(t_worker_index)
+                       : next_queue_.load() % queues_.size();
+    std::function<void()> task;
+    if (!take(index, task)) {
+        return false;
+    }
+    task();
+    return true;
+}
+
+void ThreadPool::wait_for(const std::function<bool()>& done) {
+    std::unique_lock<std::mutex> lock(sleep_mutex_);
+    wake_.wait(lock, [this, &done] { return pending_ > 0 || done(); });
+}
+
+void ThreadPool::notify_waiters() {
+    // Taking the lock orders this after a waiter's check of done()
+    {
+        std::lock_guard<std::mutex> lock(sleep_mutex_);
+    }
+    wake_.notify_all();
+}
+
+void ThreadPool::worker_loop(size_t index) {
+    t_worker_index = static_cast<int>(index);
+    t_worker_pool = this;
+
+    for (;;) {
+        std::function<void()> task;
+        if (take(index, task)) {
+            task();
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(sleep_mutex_);
+        wake_.wait(lock, [this] { return stop_ || pending_ > 0; });
+        if (stop_ && pending_ == 0) {
+            return;
+        }
+    }
+}
+
+bool ThreadPool::take(size_t index, std::function<void()>& task) {
+    // Own queue first, newest task (its data is most likely still in cache)
+    {
+        TaskQueue& own = *queues_[index];
+        std::lock_guard<std::mutex> lock(own.mutex);
+        if (!own.tasks.empty()) {
+            task = std::move(own.tasks.back());
+            own.tasks.pop_back();
+        }
+    }
+
+    // Otherwise steal the oldest task of another queue
+    for (size_t k = 1; !task && k < queues_.size(); ++k) {
+        TaskQueue& victim = *queues_[(index + k) % queues_.size()];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (!victim.tasks.empty()) {
+            task = std::move(victim.tasks.front());
+            victim.tasks.pop_front();
+        }
+    }
+
+    if (!task) {
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(sleep_mutex_);
+    pending_--;
+    return true;
+}
+
+TaskGroup::TaskGroup(ThreadPool& pool)
+    : pool_(pool) {
+}
+
+TaskGroup::~TaskGroup() {
+    // Tasks reference the group, never leave before they are done
+    try {
+        wait();
+    } catch (...) {
+    }
+}
+
+void TaskGroup::run(std::function<void()> task) {
+    remaining_++;
+    pool_.submit([this, task = std::move(task)]() {
+        try {
+            task();
+        } catch (...) {
+            std::lock_guard<std::mutex> lock(error_mutex_);
+            if (!error_) {
+                error_ = std::current_exception();
+            }
+        }
+
+        // The group may be gone as soon as remaining_ hits zero
+        ThreadPool& pool = pool_;
+        if (--remaining_ == 0) {
+            pool.notify_waiters();
+        }
+    });
+}
+
+void TaskGroup::wait() {
+    // Help with pending tasks, sleep while the remaining ones run elsewhere
+    while (remaining_ > 0) {
+        if (!pool_.try_run_one()) {
+            pool_.wait_for([this] { return remaining_ == 0; });
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(error_mutex_);
+    if (error_) {
+        std::exception_ptr error = error_;
+        error_ = nullptr;
+        std::rethrow_exception(error);
+    }
+}
@@ -0,0 +1,81 @@
+#ifndef THREAD_POOL_HPP
+#define THREAD_POOL_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Work-stealing thread pool. Every worker owns a task deque: tasks submitted
+// from a worker go to its own deque and are taken newest first, idle workers
+// steal the oldest task from the other deques. Tasks submitted from outside
+// the pool are spread over the deques round robin.
+class ThreadPool {
+public:
+    // Process-wide pool, one worker less than the hardware threads since
+    // the thread waiting on a TaskGroup helps running tasks
+    static ThreadPool& instance();
+
+    explicit ThreadPool(size_t n_workers);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    void submit(std::function<void()> task);
+
+    // Run one pending task on the calling thread, false if there was none
+    bool try_run_one();
+
+    // Block until a task is pending or done() holds. notify_waiters()
+    // makes blocked threads check done() again.
+    void wait_for(const std::function<bool()>& done);
+    void notify_waiters();
+
+    size_t size() const { return threads_.size(); }
+
+private:
+    struct TaskQueue {
+        std::mutex mutex;
+        std::deque<std::function<void()>> tasks;
+    };
+
+    std::vector<std::unique_ptr<TaskQueue>> queues_;
+    std::vector<std::thread> threads_;
+    std::atomic<size_t> next_queue_{0};
+
+    std::mutex sleep_mutex_;
+    std::condition_variable wake_;
+    size_t pending_ = 0;  // guarded by sleep_mutex_
+    bool stop_ = false;   // guarded by sleep_mutex_
+
+    void worker_loop(size_t index);
+    bool take(size_t index, std::function<void()>& task);
+};
+
+// Set of tasks that is waited for as a whole. wait() runs pending pool
+// tasks while it waits, so groups can be nested inside pool tasks, and
+// sleeps when there is nothing left to steal.
+// The first exception thrown by a task is rethrown by wait().
+class TaskGroup {
+public:
+    explicit TaskGroup(ThreadPool& pool = ThreadPool::instance());
+    ~TaskGroup();
+
+    void run(std::function<void()> task);
+    void wait();
+
+private:
+    ThreadPool& pool_;
+    std::atomic<size_t> remaining_{0};
+    std::mutex error_mutex_;
+    std::exception_ptr error_;
+};
+
+#endif // THREAD_POOL_HPP
@@ -0,0 +1,262 @@
+#include "pipeline.hpp"
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <thread>
+#include "../density/atomic_density.hpp"
+#include "../output/gnuplot_exporter.hpp"
+
+#if defined(__linux__)
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+double seconds_since(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+} // namespace
+
+Pipeline::Pipeline(std::vector<std::string> filenames, ExportOptions options, size_t depth)
+    : filenames_(std::move(filenames)),
+      options_(options),
+      depth_(depth > 0 ? depth : 1),
+      read_queue_(depth_),
+      write_queue_(depth_) {
+    results_.resize(filenames_.size());
+    for (size_t i = 0; i < filenames_.size(); ++i) {
+        results_[i].filename = filenames_[i];
+    }
+}
+
+ExitCode Pipeline::run() {
+    std::thread reader([this] { read_stage(); });
+    std::thread writer([this] { write_stage(); });
+
+    parse_stage();
+
+    reader.join();
+    writer.join();
+
+    return static_cast<ExitCode>(status_.load());
+}
+
+void Pipeline::fail(ExitCode code) {
+    // Keep the first error, later ones are usually consequences of it
+    int expected = SUCCESS;
+    status_.compare_exchange_strong(expected, code);
+    read_queue_.close();
+    write_queue_.close();
+}
+
+void Pipeline::fail(size_t index, ExitCode code) {
+    results_[index].done = true;
+    results_[index].status = code;
+    if (keep_going_) {
+        int expected = SUCCESS;
+        status_.compare_exchange_strong(expected, code);
+        return;
+    }
+    fail(code);
+}
+
+void Pipeline::read_stage() {
+    // Start the kernel readahead for the first batch of files
+    for (size_t i = 0; i < depth_ && i < filenames_.size(); ++i) {
+        advise_willneed(filenames_[i]);
+    }
+
+    for (size_t i = 0; i < filenames_.size(); ++i) {
+        // Keep the readahead window `depth` files in front of the reader
+        if (i + depth_ < filenames_.size()) {
+            advise_willneed(filenames_[i + depth_]);
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        FileBuffer buffer;
+        buffer.index = i;
+        buffer.filename = filenames_[i];
+        buffer.ok = read_file(buffer.filename, buffer.contents);
+        results_[i].read_seconds = seconds_since(start);
+        bool ok = buffer.ok;
+
+        if (!read_queue_.push(std::move(buffer)) || (!ok && !keep_going_)) {
+            break;
+        }
+    }
+
+    read_queue_.close();
+}
+
+void Pipeline::parse_stage() {
+    // Returns whether to go on with the next file
+    auto file_failed = [&](size_t index, ExitCode code) {
+        fail(index, code);
+        return keep_going_;
+    };
+
+    while (auto buffer = read_queue_.pop()) {
+        if (!buffer->ok) {
+            bool missing = !std::filesystem::exists(buffer->filename);
+            std::cerr << "Error: " << (missing ? "File '" : "Failed to read UPF file '") << buffer->filename
+                      << (missing ? "' not found\n" : "'\n");
+            if (file_failed(buffer->index, missing ? ERROR_FILE_NOT_FOUND : ERROR_FILE_READ)) {
+                continue;
+            }
+            break;
+        }
+
+        try {
+            auto start = std::chrono::steady_clock::now();
+            auto reader = std::make_unique<UPFReader>(buffer->filename);
+
+            // Read and parse the UPF file
+            if (!reader->load_buffer(std::move(buffer->contents))) {
+                std::cerr << "Error: Failed to parse UPF file '" << buffer->filename << "'\n";
+                if (file_failed(buffer->index, ERROR_XML_PARSE)) {
+                    continue;
+                }
+                break;
+            }
+
+            FileResult& result = results_[buffer->index];
+            result.element = trimmed(reader->data().header.element);
+            result.parse_seconds = seconds_since(start);
+
+            // Hand the parsed data to the writer
+            ExportJob job;
+            job.index = buffer->index;
+            job.element = reader->data().header.element;
+            job.reader = std::move(reader);
+            if (!write_queue_.push(std::move(job))) {
+                break;
+            }
+        } catch (const std::exception& e) {
+            std::cerr << "Error: " << e.what() << "\n";
+            if (file_failed(buffer->index, ERROR_FILE_READ)) {
+                continue;
+            }
+            break;
+        }
+    }
+
+    // Unblock the reader if parsing stopped early, let the writer drain
+    read_queue_.close();
+    write_queue_.close();
+}
+
+void Pipeline::write_stage() {
+    std::vector<ExportJob> batch;
+    while (auto job = write_queue_.pop()) {
+        // Batch the files that are already parsed, never wait for more
+        batch.clear();
+        batch.push_back(std::move(*job));
+        while (batch.size() < depth_) {
+            auto next = write_queue_.try_pop();
+            if (!next) {
+                break;
+            }
+            batch.push_back(std::move(*next));
+        }
+
+        std::vector<UPFData*> data;
+        for (auto& entry : batch) {
+            data.push_back(&entry.reader->data());
+        }
+        compute_hartree_potentials(data);
+
+        for (auto& entry : batch) {
+            if (!export_job(entry)) {
+                return;
+            }
+        }
+    }
+}
+
+bool Pipeline::export_job(ExportJob& job) {
+    try {
+        auto start = std::chrono::steady_clock::now();
+
+        // Process and display the UPF data
+        job.reader->display_info();
+
+        // Create output directory for this element (or this file)
+        std::filesystem::path output_dir = unique_output_dirs_
+                                               ? unique_output_dir(results_[job.index].filename, job.element)
+                                               : std::filesystem::path("gnuplot/" + job.element);
+
+        // Export data using gnuplot exporter with element name
+        GnuplotExporter exporter(output_dir, job.element, std::move(job.reader->data()));
+        exporter.set_options(options_);
+        if (!exporter.export_all()) {
+            std::cerr << "Error: Failed to export orbital data\n";
+            fail(job.index, ERROR_FILE_WRITE);
+            return keep_going_;
+        }
+        output_dirs_.push_back(output_dir);
+
+        FileResult& result = results_[job.index];
+        result.output_dir = output_dir;
+        result.export_seconds = seconds_since(start);
+        result.done = true;
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << "\n";
+        fail(job.index, ERROR_FILE_WRITE);
+        return keep_going_;
+    }
+    return true;
+}
+
+std::filesystem::path Pipeline::unique_output_dir(const std::string& filename, const std::string& element) {
+    // FNV-1a of the path as given, the stem alone is not unique (a/Si.upf, b/Si.upf)
+    uint64_t hash = 14695981039346656037ull;
+    for (unsigned char c : filename) {
+        hash ^= c;
+        hash *= 1099511628211ull;
+    }
+    char suffix[16];
+    std::snprintf(suffix, sizeof(suffix), "-%08x", static_cast<unsigned>(hash ^ (hash >> 32)));
+
+    std::string name = trimmed(element);
+    if (name.empty()) {
+        name = "unknown";
+    }
+
+    return std::filesystem::path("gnuplot") / name / (std::filesystem::path(filename).stem().string() + suffix);
+}
+
+void Pipeline::advise_willneed(const std::string& filename) {
+#if defined(__linux__)
+    // Ask the kernel to start reading the whole file in the background
+    int fd = ::open(filename.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return;
+    }
+    ::posix_fadvise(fd, 0, 0, POSIX_FADV_WILLNEED);
+    ::close(fd);
+#else
+    (void)filename;
+#endif
+}
+
+bool Pipeline::read_file(const std::string& filename, std::vector<char>& contents) {
+    std::error_code ec;
+    auto size = std::filesystem::file_size(filename, ec);
+    if (ec) {
+        return false;
+    }
+
+    std::ifstream file(filename, std::ios::binary);
+    if (!file) {
+        return false;
+    }
+
+    contents.resize(static_cast<size_t>(size));
+    file.read(contents.data(), static_cast<std::streamsize>(size));
+    return static_cast<size_t>(file.gcount()) == contents.size();
+}
@@ -0,0 +1,106 @@
+#ifndef PIPELINE_HPP
+#define PIPELINE_HPP
+
+#include <atomic>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <vector>
+#include "../globals/globals.hpp"
+#include "../UPF_reader/UPF_reader.hpp"
+#include "bounded_queue.hpp"
+#include "../output/gnuplot_exporter.hpp"
+
+// Three stage processing of a list of UPF files:
+//   reader  - prefetches upcoming files (posix_fadvise) and reads them into memory
+//   parser  - parses the XML and computes the potentials (runs on the calling thread)
+//   writer  - solves the Hartree potentials of the files that are already parsed
+//             (up to `depth`) as one batch, then displays and exports them through
+//             GnuplotExporter asynchronously, it never waits for a batch to fill
+// Stages are connected by bounded queues, so at most `depth` files are
+// in flight between two stages and the run time approaches the slowest stage.
+class Pipeline {
+public:
+    explicit Pipeline(std::vector<std::string> filenames, ExportOptions options = {}, size_t depth = 4);
+
+    // Process all files, returns SUCCESS or the ExitCode of the first failure
+    ExitCode run();
+
+    // Write every file to gnuplot/<element>/<stem>-<hash of its path> instead
+    // of gnuplot/<element>, variants of an element then never share a
+    // directory. The name only depends on the input path, so it is the
+    // same in every shard of a run.
+    void set_unique_output_dirs(bool unique) { unique_output_dirs_ = unique; }
+    static std::filesystem::path unique_output_dir(const std::string& filename, const std::string& element);
+
+    // Record a file that cannot be read, parsed or exported in its result
+    // and go on with the others instead of stopping. run() still returns
+    // the first failure.
+    void set_keep_going(bool keep_going) { keep_going_ = keep_going; }
+
+    // Output directories written by the writer stage, in processing order
+    const std::vector<std::filesystem::path>& output_dirs() const { return output_dirs_; }
+
+    // Outcome and stage timings of one input file
+    struct FileResult {
+        std::string filename;
+        std::string element;        // PP_HEADER element without padding
+        std::filesystem::path output_dir;
+        bool done = false;          // exported, or failed with `status`
+        ExitCode status = SUCCESS;
+        double read_seconds = 0.0;
+        double parse_seconds = 0.0;
+        double export_seconds = 0.0;
+    };
+
+    // One entry per input file in input order, complete after run()
+    const std::vector<FileResult>& results() const { return results_; }
+
+private:
+    struct FileBuffer {
+        size_t index;
+        std::string filename;
+        std::vector<char> contents;
+        bool ok;
+    };
+
+    // The reader travels with its data, display_info() shows the charges
+    // of the Hartree solve
+    struct ExportJob {
+        size_t index;
+        std::string element;
+        std::unique_ptr<UPFReader> reader;
+    };
+
+    std::vector<std::string> filenames_;
+    ExportOptions options_;
+    size_t depth_;
+    bool unique_output_dirs_ = false;
+    bool keep_going_ = false;
+    std::vector<std::filesystem::path> output_dirs_;
+    std::vector<FileResult> results_;  // every stage only writes its own fields
+
+    BoundedQueue<FileBuffer> read_queue_;
+    BoundedQueue<ExportJob> write_queue_;
+    std::atomic<int> status_{SUCCESS};
+
+    // Stage bodies
+    void read_stage();
+    void parse_stage();
+    void write_stage();
+
+    // Export one job of the writer's batch, false to stop the writer
+    bool export_job(ExportJob& job);
+
+    // Record the first failure and stop all stages
+    void fail(ExitCode code);
+
+    // Record the failure of one file, stops all stages unless keep_going_
+    void fail(size_t index, ExitCode code);
+
+    // Helper functions
+    static void advise_willneed(const std::string& filename);
+    static bool read_file(const std::string& filename, std::vector<char>& contents);
+};
+
+#endif // PIPELINE_HPP
@@ -0,0 +1,539 @@
+#include "projector_grid.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <sstream>
+#include "../UPF_reader/UPF_reader.hpp"
+#include "../parallel/parallel.hpp"
+#include "spherical_harmonics.hpp"
+
+namespace {
+
+double dot(const std::array<double, 3>& a, const std::array<double, 3>& b) {
+    return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+}
+
+std::array<double, 3> cross(const std::array<double, 3>& a, const std::array<double, 3>& b) {
+    return {a[1] * b[2] - a[2] * b[1], a[2] * b[0] - a[0] * b[2], a[0] * b[1] - a[1] * b[0]};
+}
+
+template <typename T>
+void write_value(std::ofstream& out, const T& value) {
+    out.write(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+template <typename T>
+void write_array(std::ofstream& out, const std::vector<T>& values) {
+    out.write(reinterpret_cast<const char*>(values.data()), static_cast<std::streamsize>(values.size() * sizeof(T)));
+}
+
+} // namespace
+
+bool GridStructure::read(const std::filesystem::path& path, GridStructure& structure) {
+    std::ifstream file(path);
+    if (!file) {
+        std::cerr << "Error: Cannot read structure '" << path.string() << "'\n";
+        return false;
+    }
+
+    std::filesystem::path base = path.parent_path();
+    size_t lattice_rows = 0;
+    size_t line_number = 0;
+    std::string line;
+    while (std::getline(file, line)) {
+        ++line_number;
+        line = trimmed(line.substr(0, line.find('#')));
+        if (line.empty()) {
+            continue;
+        }
+
+        std::istringstream fields(line);
+        std::string keyword;
+        fields >> keyword;
+        bool ok = false;
+        if (keyword == "lattice" && lattice_rows < 3) {
+            auto& row = structure.lattice[lattice_rows++];
+            ok = static_cast<bool>(fields >> row[0] >> row[1] >> row[2]);
+        } else if (keyword == "spacing") {
+            ok = (fields >> structure.spacing) && structure.spacing > 0.0;
+        } else if (keyword == "species") {
+            std::string element;
+            std::string file_name;
+            ok = static_cast<bool>(fields >> element >> file_name);
+            std::filesystem::path species_path = file_name;
+            if (ok && species_path.is_relative()) {
+                species_path = (base / species_path).lexically_normal();
+            }
+            structure.species[element] = species_path;
+        } else if (keyword == "atom") {
+            Atom atom;
+            ok = static_cast<bool>(fields >> atom.element >> atom.position[0] >> atom.position[1] >> atom.position[2]);
+            structure.atoms.push_back(atom);
+        }
+
+        std::string rest;
+        if (!ok || fields >> rest) {
+            std::cerr << "Error: " << path.string() << ":" << line_number << ": Cannot parse '" << line << "'\n";
+            return false;
+        }
+    }
+
+    if (lattice_rows != 3) {
+        std::cerr << "Error: " << path.string() << ": Expected three lattice lines\n";
+        return false;
+    }
+    for (const auto& atom : structure.atoms) {
+        if (structure.species.find(atom.element) == structure.species.end()) {
+            std::cerr << "Error: " << path.string() << ": No species line for '" << atom.element << "'\n";
+            return false;
+        }
+    }
+
+    return true;
+}
+
+ProjectorGrid::ProjectorGrid(GridStructure structure)
+    : structure_(std::move(structure)) {
+}
+
+bool ProjectorGrid::build() {
+    atoms_.clear();
+
+    const auto& a = structure_.lattice;
+    double volume = dot(a[0], cross(a[1], a[2]));
+    if (std::abs(volume) < 1e-12) {
+        std::cerr << "Error: The lattice vectors do not span a cell\n";
+        return false;
+    }
+
+    // b_i = (a_j x a_k) / V, the fractional coordinate along a_i is b_i . r
+    for (size_t d = 0; d < 3; ++d) {
+        auto b = cross(a[(d + 1) % 3], a[(d + 2) % 3]);
+        for (size_t e = 0; e < 3; ++e) {
+            reciprocal_[d][e] = b[e] / volume;
+        }
+    }
+
+    size_t points = 1;
+    for (size_t d = 0; d < 3; ++d) {
+        double length = std::sqrt(dot(a[d], a[d]));
+        dims_[d] = std::max<size_t>(1, static_cast<size_t>(std::ceil(length / structure_.spacing - 1e-9)));
+        points *= dims_[d];
+    }
+    if (points > std::numeric_limits<uint32_t>::max()) {
+        std::cerr << "Error: Grid of " << points << " points does not fit 32-bit indices\n";
+        return false;
+    }
+
+    for (const auto& entry : structure_.species) {
+        if (entry.first.size() >= LABEL_SIZE) {
+            std::cerr << "Error: Species label '" << entry.first << "' is longer than " << LABEL_SIZE - 1
+                      << " characters\n";
+            return false;
+        }
+    }
+
+    if (!load_species()) {
+        return false;
+    }
+
+    for (const auto& site : structure_.atoms) {
+        const Species& species = species_.at(site.element);
+        AtomBlock atom;
+        atom.element = site.element;
+        atom.position = site.position;
+        atom.projector_radius = species.projector_radius;
+        atom.local_radius = species.local_radius;
+        for (const auto& beta : species.data.betas) {
+            for (int m = -beta.l; m <= beta.l; ++m) {
+                atom.projectors.push_back({beta.index, beta.l, m});
+            }
+        }
+        atoms_.push_back(std::move(atom));
+    }
+
+    // One work item per slab of grid planes of every sphere, large and small
+    // atoms balance out
+    struct Task {
+        size_t atom;
+        bool local;
+        Box box;
+        long first;
+        long last;
+    };
+    std::vector<Task> tasks;
+    std::vector<std::array<size_t, 2>> first_task(atoms_.size());  // per atom: projector, local
+    for (size_t i = 0; i < atoms_.size(); ++i) {
+        for (bool local : {false, true}) {
+            first_task[i][local] = tasks.size();
+            double radius = local ? atoms_[i].local_radius : atoms_[i].projector_radius;
+            if (radius <= 0.0 || (!local && atoms_[i].projectors.empty())) {
+                continue;
+            }
+            Box box = bounding_box(atoms_[i], radius);
+            for (long first = box[0][0]; first <= box[0][1]; first += SLAB_PLANES) {
+                long last = std::min<long>(first + SLAB_PLANES - 1, box[0][1]);
+                tasks.push_back({i, local, box, first, last});
+            }
+        }
+    }
+
+    std::vector<Samples> slabs(tasks.size());
+    parallel_for(tasks.size(), [&](size_t t) {
+        const Task& task = tasks[t];
+        const AtomBlock& atom = atoms_[task.atom];
+        slabs[t] = sample(species_.at(atom.element), atom, task.local, task.box, task.first, task.last);
+    });
+
+    // Tasks of one sphere are consecutive
+    parallel_for(atoms_.size(), [&](size_t i) {
+        AtomBlock& atom = atoms_[i];
+        size_t end_projector = first_task[i][1];
+        size_t end_local = i + 1 < atoms_.size() ? first_task[i + 1][0] : tasks.size();
+        std::vector<Samples> projector_slabs(std::make_move_iterator(slabs.begin() + first_task[i][0]),
+                                             std::make_move_iterator(slabs.begin() + end_projector));
+        std::vector<Samples> local_slabs(std::make_move_iterator(slabs.begin() + end_projector),
+                                         std::make_move_iterator(slabs.begin() + end_local));
+        merge(projector_slabs, atom.projectors.size(), atom.indices, atom.values);
+        merge(local_slabs, 1, atom.local_indices, atom.local_values);
+    });
+
+    return true;
+}
+
+bool ProjectorGrid::load_species() {
+    species_.clear();
+    std::vector<std::string> elements;
+    for (const auto& entry : structure_.species) {
+        elements.push_back(entry.first);
+        species_[entry.first];
+    }
+
+    // Parse all species in parallel, load() does not touch the global data
+    std::atomic<bool> ok{true};
+    parallel_for(elements.size(), [&](size_t i) {
+        const std::filesystem::path& path = structure_.species.at(elements[i]);
+        Species& species = species_.at(elements[i]);
+        UPFReader reader(path.string());
+        if (!reader.load()) {
+            std::cerr << "Error: Could not parse '" << path.string() << "'\n";
+            ok = false;
+            return;
+        }
+        species.data = reader.data();
+        if (!prepare_species(species)) {
+            std::cerr << "Error: Cannot sample '" << path.string() << "' on a grid\n";
+            ok = false;
+        }
+    });
+
+    return ok;
+}
+
+bool ProjectorGrid::prepare_species(Species& species) {
+    const RadialMesh* mesh = species.data.mesh.get();
+    if (!mesh || mesh->size() < 2) {
+        return false;
+    }
+    const std::vector<double>& r = mesh->r();
+    size_t n = mesh->size();
+
+    // beta(r) from r beta(r). At r = 0 only l = 0 is nonzero, take the
+    // neighbour. The sphere ends where the last beta becomes negligible.
+    species.betas.clear();
+    species.projector_radius = 0.0;
+    for (const auto& beta : species.data.betas) {
+        if (beta.l < 0 || beta.l > MAX_HARMONIC_L) {
+            std::cerr << "Error: PP_BETA." << beta.index << " has l = " << beta.l << ", only l <= "
+                      << MAX_HARMONIC_L << " is supported\n";
+            return false;
+        }
+
+        size_t n_r = std::min(beta.values.size(), n);
+        if (beta.cutoff_radius_index > 0) {
+            n_r = std::min(n_r, static_cast<size_t>(beta.cutoff_radius_index) + 1);
+        }
+        std::vector<double> table(n, 0.0);
+        double peak = 0.0;
+        for (size_t i = 0; i < n_r; ++i) {
+            table[i] = r[i] > 0.0 ? beta.values[i] / r[i] : 0.0;
+            peak = std::max(peak, std::abs(beta.values[i]));
+        }
+        if (r[0] <= 0.0 && beta.l == 0) {
+            table[0] = table[1];
+        }
+        while (n_r > 0 && std::abs(beta.values[n_r - 1]) <= 1e-12 * peak) {
+            --n_r;
+        }
+        if (n_r > 0) {
+            species.projector_radius = std::max(species.projector_radius, r[n_r - 1]);
+        }
+        species.betas.push_back(std::move(table));
+    }
+
+    // V_loc + 2Z erf(r/r_loc)/r, the erf term is 4Z/(sqrt(pi) r_loc) at r = 0
+    species.local.clear();
+    species.local_radius = 0.0;
+    size_t n_local = std::min(species.data.local_potential.size(), n);
+    if (n_local == 0) {
+        return true;
+    }
+    double z = species.data.header.z_valence;
+    species.local.assign(n, 0.0);
+    for (size_t i = 0; i < n_local; ++i) {
+        double coulomb = r[i] > 0.0 ? 2.0 * z * std::erf(r[i] / LOCAL_GAUSSIAN_RADIUS) / r[i]
+                                    : 4.0 * z / (std::sqrt(M_PI) * LOCAL_GAUSSIAN_RADIUS);
+        species.local[i] = species.data.local_potential[i] + coulomb;
+    }
+
+    // Beyond the point where erf(r/r_loc) = 1 to the tolerance (and the
+    // pseudized core, which ends before the projectors do) V_sr is only the
+    // rounding noise of PP_LOCAL against -2Z/r. Inside, the sphere ends
+    // where |V_sr| stays below the tolerance relative to 2Z/r.
+    size_t cap = 0;
+    while (cap + 1 < n_local &&
+           (std::erfc(r[cap] / LOCAL_GAUSSIAN_RADIUS) >= LOCAL_TOLERANCE || r[cap] < species.projector_radius)) {
+        ++cap;
+    }
+    size_t last = cap;
+    while (last > 0 && std::abs(species.local[last]) * r[last] < LOCAL_TOLERANCE * 2.0 * std::max(z, 1.0)) {
+        --last;
+    }
+    species.local_radius = r[std::min(last + 1, cap)];
+
+    return true;
+}
+
+ProjectorGrid::Box ProjectorGrid::bounding_box(const AtomBlock& atom, double radius) const {
+    // The sphere spans radius |b_d| in fractional coordinate d
+    Box box;
+    for (size_t d = 0; d < 3; ++d) {
+        double center = dot(reciprocal_[d], atom.position);
+        double half_width = radius * std::sqrt(dot(reciprocal_[d], reciprocal_[d]));
+        box[d][0] = static_cast<long>(std::ceil((center - half_width) * dims_[d]));
+        box[d][1] = static_cast<long>(std::floor((center + half_width) * dims_[d]));
+    }
+    return box;
+}
+
+ProjectorGrid::Samples ProjectorGrid::sample(const Species& species, const AtomBlock& atom, bool local,
+                                             const Box& box, long first, long last) const {
+    const auto& a = structure_.lattice;
+    double radius = local ? atom.local_radius : atom.projector_radius;
+    double radius2 = radius * radius;
+
+    // Points inside the sphere, unwrapped positions relative to the atom.
+    // Their wrapped indices may repeat when the sphere overlaps its own
+    // periodic image, merge() adds those up.
+    Samples samples;
+    std::vector<double> x;
+    std::vector<double> y;
+    std::vector<double> z;
+    std::vector<double> distance;
+    for (long i = first; i <= last; ++i) {
+        double fi = static_cast<double>(i) / dims_[0];
+        size_t wi = static_cast<size_t>(((i % static_cast<long>(dims_[0])) + dims_[0]) % dims_[0]);
+        for (long j = box[1][0]; j <= box[1][1]; ++j) {
+            double fj = static_cast<double>(j) / dims_[1];
+            size_t wj = static_cast<size_t>(((j % static_cast<long>(dims_[1])) + dims_[1]) % dims_[1]);
+            for (long k = box[2][0]; k <= box[2][1]; ++k) {
+                double fk = static_cast<double>(k) / dims_[2];
+                double dx = fi * a[0][0] + fj * a[1][0] + fk * a[2][0] - atom.position[0];
+                double dy = fi * a[0][1] + fj * a[1][1] + fk * a[2][1] - atom.position[1];
+                double dz = fi * a[0][2] + fj * a[1][2] + fk * a[2][2] - atom.position[2];
+                double d2 = dx * dx + dy * dy + dz * dz;
+                if (d2 > radius2) {
+                    continue;
+                }
+                size_t wk = static_cast<size_t>(((k % static_cast<long>(dims_[2])) + dims_[2]) % dims_[2]);
+                samples.indices.push_back(static_cast<uint32_t>((wi * dims_[1] + wj) * dims_[2] + wk));
+                x.push_back(dx);
+                y.push_back(dy);
+                z.push_back(dz);
+                distance.push_back(std::sqrt(d2));
+            }
+        }
+    }
+
+    size_t n = samples.indices.size();
+    if (n == 0) {
+        return samples;
+    }
+
+    // Unit vectors, zero at the atom itself where only l = 0 survives
+    for (size_t p = 0; p < n; ++p) {
+        double inverse = distance[p] > 0.0 ? 1.0 / distance[p] : 0.0;
+        x[p] *= inverse;
+        y[p] *= inverse;
+        z[p] *= inverse;
+    }
+
+    const RadialMesh& mesh = *species.data.mesh;
+    MeshInterpolation interpolation = mesh.interpolation_to(distance);
+    std::vector<double> radial(n);
+    auto interpolate = [&](const std::vector<double>& table) {
+        for (size_t p = 0; p < n; ++p) {
+            size_t i = interpolation.index[p];
+            double w = interpolation.weight[p];
+            radial[p] = (1.0 - w) * table[i] + w * table[i + 1];
+        }
+    };
+
+    if (local) {
+        interpolate(species.local);
+        samples.values = std::move(radial);
+        return samples;
+    }
+
+    samples.values.resize(atom.projectors.size() * n);
+    std::vector<double> harmonics((2 * MAX_HARMONIC_L + 1) * n);
+    size_t row = 0;
+    for (size_t b = 0; b < species.betas.size(); ++b) {
+        int l = species.data.betas[b].l;
+        interpolate(species.betas[b]);
+        real_spherical_harmonics(l, n, x.data(), y.data(), z.data(), harmonics.data());
+        for (int m = 0; m < 2 * l + 1; ++m) {
+            double* out = samples.values.data() + (row + m) * n;
+            const double* ylm = harmonics.data() + m * n;
+            for (size_t p = 0; p < n; ++p) {
+                out[p] = radial[p] * ylm[p];
+            }
+        }
+        row += 2 * l + 1;
+    }
+
+    return samples;
+}
+
+void ProjectorGrid::merge(std::vector<Samples>& slabs, size_t rows, std::vector<uint32_t>& indices,
+                          std::vector<double>& values) {
+    // Sort the points of all slabs by grid index, repeated indices (periodic
+    // images of the same sphere) are summed
+    struct Point {
+        uint32_t index;
+        uint32_t slab;
+        uint32_t column;
+    };
+    std::vector<Point> points;
+    for (size_t s = 0; s < slabs.size(); ++s) {
+        for (size_t c = 0; c < slabs[s].indices.size(); ++c) {
+            points.push_back({slabs[s].indices[c], static_cast<uint32_t>(s), static_cast<uint32_t>(c)});
+        }
+    }
+    std::sort(points.begin(), points.end(), [](const Point& a, const Point& b) {
+        return a.index < b.index;
+    });
+
+    indices.clear();
+    for (size_t p = 0; p < points.size(); ++p) {
+        if (p == 0 || points[p].index != points[p - 1].index) {
+            indices.push_back(points[p].index);
+        }
+    }
+
+    size_t n = indices.size();
+    values.assign(rows * n, 0.0);
+    size_t column = 0;
+    for (size_t p = 0; p < points.size(); ++p) {
+        if (p > 0 && points[p].index != points[p - 1].index) {
+            ++column;
+        }
+        const Samples& slab = slabs[points[p].slab];
+        size_t slab_n = slab.indices.size();
+        for (size_t row = 0; row < rows; ++row) {
+            values[row * n + column] += slab.values[row * slab_n + points[p].column];
+        }
+    }
+}
+
+bool ProjectorGrid::write(const std::filesystem::path& path) const {
+    // Write to a temporary name first, readers never see half a file
+    std::filesystem::path tmp = path;
+    tmp += ".tmp";
+    {
+        std::ofstream out(tmp, std::ios::binary);
+        if (!out) {
+            std::cerr << "Error: Cannot write '" << path.string() << "'\n";
+            return false;
+        }
+
+        out.write(FILE_MAGIC, sizeof(FILE_MAGIC));
+        write_value(out, FILE_VERSION);
+        write_value(out, uint32_t{0x01020304});
+        for (size_t d = 0; d < 3; ++d) {
+            write_value(out, static_cast<uint32_t>(dims_[d]));
+        }
+        write_value(out, static_cast<uint32_t>(atoms_.size()));
+        for (const auto& row : structure_.lattice) {
+            for (double value : row) {
+                write_value(out, value);
+            }
+        }
+        write_value(out, LOCAL_GAUSSIAN_RADIUS);
+
+        for (const auto& atom : atoms_) {
+            char element[LABEL_SIZE] = {};
+            atom.element.copy(element, LABEL_SIZE - 1);
+            out.write(element, sizeof(element));
+            for (double value : atom.position) {
+                write_value(out, value);
+            }
+            write_value(out, static_cast<uint32_t>(atom.projectors.size()));
+            write_value(out, static_cast<uint32_t>(atom.indices.size()));
+            for (const auto& projector : atom.projectors) {
+                write_value(out, static_cast<int32_t>(projector.beta));
+                write_value(out, static_cast<int32_t>(projector.l));
+                write_value(out, static_cast<int32_t>(projector.m));
+            }
+            write_array(out, atom.indices);
+            write_array(out, atom.values);
+            write_value(out, static_cast<uint32_t>(atom.local_indices.size()));
+            write_array(out, atom.local_indices);
+            write_array(out, atom.local_values);
+        }
+
+        if (!out) {
+            std::cerr << "Error: Cannot write '" << path.string() << "'\n";
+            return false;
+        }
+    }
+
+    std::error_code ec;
+    std::filesystem::rename(tmp, path, ec);
+    if (ec) {
+        std::cerr << "Error: Cannot write '" << path.string() << "'\n";
+        return false;
+    }
+
+    return true;
+}
+
+void ProjectorGrid::write_summary(std::ostream& out) const {
+    const auto& a = structure_.lattice;
+    out << "Grid " << dims_[0] << " x " << dims_[1] << " x " << dims_[2] << ", spacing";
+    out << std::fixed << std::setprecision(4);
+    for (size_t d = 0; d < 3; ++d) {
+        out << " " << std::sqrt(dot(a[d], a[d])) / dims_[d];
+    }
+    out << " bohr\n";
+
+    out << std::left << std::setw(6) << "Atom" << std::setw(8) << "Element" << std::right << std::setw(10)
+        << "r_beta" << std::setw(8) << "proj" << std::setw(10) << "points" << std::setw(10) << "r_loc"
+        << std::setw(10) << "points" << "\n";
+    size_t bytes = 0;
+    for (size_t i = 0; i < atoms_.size(); ++i) {
+        const AtomBlock& atom = atoms_[i];
+        out << std::left << std::setw(6) << i + 1 << std::setw(8) << atom.element << std::right
+            << std::setprecision(2) << std::setw(10) << atom.projector_radius << std::setw(8)
+            << atom.projectors.size() << std::setw(10) << atom.indices.size() << std::setw(10)
+            << atom.local_radius << std::setw(10) << atom.local_indices.size() << "\n";
+        bytes += atom.indices.size() * (sizeof(uint32_t) + atom.projectors.size() * sizeof(double))
+               + atom.local_indices.size() * (sizeof(uint32_t) + sizeof(double));
+    }
+    out << std::setprecision(1) << "Sparse blocks: " << bytes / 1048576.0 << " MiB\n";
+    out << std::defaultfloat;
+}
@@ -0,0 +1,139 @@
+#ifndef PROJECTOR_GRID_HPP
+#define PROJECTOR_GRID_HPP
+
+#include <array>
+#include <cstdint>
+#include <filesystem>
+#include <map>
+#include <ostream>
+#include <string>
+#include <vector>
+#include "../globals/globals.hpp"
+
+// Cell, grid spacing and atoms the real-space grids are built for, read
+// from a structure file with one keyword per line (lengths in bohr):
+//     lattice <x> <y> <z>          three times, the cell vectors
+//     spacing <h>                  target grid spacing
+//     species <element> <file>     UPF file of an element
+//     atom <element> <x> <y> <z>   Cartesian position
+// '#' starts a comment, relative files are resolved against the
+// structure file.
+struct GridStructure {
+    std::array<std::array<double, 3>, 3> lattice{};
+    double spacing = 0.3;
+    std::map<std::string, std::filesystem::path> species;
+
+    struct Atom {
+        std::string element;
+        std::array<double, 3> position{};
+    };
+    std::vector<Atom> atoms;
+
+    static bool read(const std::filesystem::path& path, GridStructure& structure);
+};
+
+// Samples the projectors beta_i(|r - R|) Y_lm(r - R) and the local
+// potential of every atom on the Cartesian grid
+//     r_ijk = i/n1 a1 + j/n2 a2 + k/n3 a3
+// of a periodic cell. Projectors only live inside their cutoff sphere,
+// each atom gets a sparse block: the flat grid indices (i n2 + j) n3 + k
+// inside the sphere and one row of values per (beta, m).
+//
+// V_loc has a -2Z/r tail and cannot be cut off. The block holds its short
+// range part V_loc(r) + 2Z erf(r/r_loc)/r instead, the solver adds the
+// potential of the Gaussian charge -Z exp(-r^2/r_loc^2)/(pi^1.5 r_loc^3)
+// through its Poisson solve.
+//
+// Species files are parsed in parallel, then every atom's bounding box is
+// split into slabs of grid planes and the slabs are sampled in parallel.
+class ProjectorGrid {
+public:
+    static constexpr double LOCAL_GAUSSIAN_RADIUS = 1.0;  // r_loc, bohr
+    static constexpr double LOCAL_TOLERANCE = 1e-6;       // short range part cut relative to 2Z/r
+    static constexpr size_t SLAB_PLANES = 4;              // grid planes per work item
+
+    // Binary layout, native byte order (the marker tells readers which):
+    //     char[8]  magic "UPFGRID\0"
+    //     uint32   version, byte order marker 0x01020304
+    //     uint32   n1, n2, n3, atom count
+    //     double   lattice[3][3] (rows are the cell vectors), r_loc
+    //   per atom:
+    //     char[4]  element label, NUL terminated (at most 3 characters)
+    //     double   position[3]
+    //     uint32   projector count P, point count N
+    //     int32    beta index, l, m         P times
+    //     uint32   grid index               N times
+    //     double   value[P][N]
+    //     uint32   local point count M
+    //     uint32   grid index               M times
+    //     double   short range V_loc        M times (Ry)
+    static constexpr char FILE_MAGIC[8] = {'U', 'P', 'F', 'G', 'R', 'I', 'D', '\0'};
+    static constexpr uint32_t FILE_VERSION = 1;
+    static constexpr size_t LABEL_SIZE = 4;
+
+    explicit ProjectorGrid(GridStructure structure);
+
+    // Parse the species and sample all atoms, false on errors
+    bool build();
+
+    bool write(const std::filesystem::path& path) const;
+
+    // Grid and per-atom block sizes
+    void write_summary(std::ostream& out) const;
+
+    struct Projector {
+        int beta = 0;  // PP_BETA index
+        int l = 0;
+        int m = 0;
+    };
+
+    struct AtomBlock {
+        std::string element;
+        std::array<double, 3> position{};
+        double projector_radius = 0.0;
+        std::vector<Projector> projectors;
+        std::vector<uint32_t> indices;
+        std::vector<double> values;  // projectors.size() rows of indices.size()
+        double local_radius = 0.0;
+        std::vector<uint32_t> local_indices;
+        std::vector<double> local_values;
+    };
+
+    const std::array<size_t, 3>& dims() const { return dims_; }
+    const std::vector<AtomBlock>& atoms() const { return atoms_; }
+
+private:
+    // Radial tables of one element on its own mesh
+    struct Species {
+        UPFData data;
+        std::vector<std::vector<double>> betas;  // beta(r), not r beta(r)
+        double projector_radius = 0.0;
+        std::vector<double> local;               // short range V_loc
+        double local_radius = 0.0;
+    };
+
+    // Unwrapped grid index range [first, last] per axis around a sphere
+    using Box = std::array<std::array<long, 2>, 3>;
+
+    // Grid points of one slab of a sphere and the values there
+    struct Samples {
+        std::vector<uint32_t> indices;
+        std::vector<double> values;  // rows of indices.size()
+    };
+
+    GridStructure structure_;
+    std::array<size_t, 3> dims_{};
+    std::array<std::array<double, 3>, 3> reciprocal_{};  // b_i . a_j = delta_ij
+    std::map<std::string, Species> species_;
+    std::vector<AtomBlock> atoms_;
+
+    bool load_species();
+    static bool prepare_species(Species& species);
+    Box bounding_box(const AtomBlock& atom, double radius) const;
+    Samples sample(const Species& species, const AtomBlock& atom, bool local, const Box& box, long first,
+                   long last) const;
+    static void merge(std::vector<Samples>& slabs, size_t rows, std::vector<uint32_t>& indices,
+                      std::vector<double>& values);
+};
+
+#endif // PROJECTOR_GRID_HPP
@@ -0,0 +1,72 @@
+#include "spherical_harmonics.hpp"
+
+bool real_spherical_harmonics(int l, size_t n, const double* x, const double* y, const double* z,
+                              double* out) {
+    switch (l) {
+        case 0: {
+            const double c0 = 0.28209479177387814;  // 1/(2 sqrt(pi))
+            for (size_t k = 0; k < n; ++k) {
+                out[k] = c0;
+            }
+            return true;
+        }
+        case 1: {
+            const double c1 = 0.4886025119029199;  // sqrt(3/(4 pi))
+            double* ym1 = out;
+            double* y0 = out + n;
+            double* yp1 = out + 2 * n;
+            for (size_t k = 0; k < n; ++k) {
+                ym1[k] = c1 * y[k];
+                y0[k] = c1 * z[k];
+                yp1[k] = c1 * x[k];
+            }
+            return true;
+        }
+        case 2: {
+            const double c2 = 1.0925484305920792;   // sqrt(15/(4 pi))
+            const double c20 = 0.31539156525252005;  // sqrt(5/(16 pi))
+            const double c22 = 0.5462742152960396;   // sqrt(15/(16 pi))
+            double* ym2 = out;
+            double* ym1 = out + n;
+            double* y0 = out + 2 * n;
+            double* yp1 = out + 3 * n;
+            double* yp2 = out + 4 * n;
+            for (size_t k = 0; k < n; ++k) {
+                ym2[k] = c2 * x[k] * y[k];
+                ym1[k] = c2 * y[k] * z[k];
+                y0[k] = c20 * (3.0 * z[k] * z[k] - 1.0);
+                yp1[k] = c2 * x[k] * z[k];
+                yp2[k] = c22 * (x[k] * x[k] - y[k] * y[k]);
+            }
+            return true;
+        }
+        case 3: {
+            const double c33 = 0.5900435899266435;  // sqrt(35/(32 pi))
+            const double c32 = 2.890611442640554;   // sqrt(105/(4 pi))
+            const double c31 = 0.4570457994644658;  // sqrt(21/(32 pi))
+            const double c30 = 0.3731763325901154;  // sqrt(7/(16 pi))
+            double* ym3 = out;
+            double* ym2 = out + n;
+            double* ym1 = out + 2 * n;
+            double* y0 = out + 3 * n;
+            double* yp1 = out + 4 * n;
+            double* yp2 = out + 5 * n;
+            double* yp3 = out + 6 * n;
+            for (size_t k = 0; k < n; ++k) {
+                double xx = x[k] * x[k];
+                double yy = y[k] * y[k];
+                double zz = z[k] * z[k];
+                ym3[k] = c33 * y[k] * (3.0 * xx - yy);
+                ym2[k] = c32 * x[k] * y[k] * z[k];
+                ym1[k] = c31 * y[k] * (5.0 * zz - 1.0);
+                y0[k] = c30 * z[k] * (5.0 * zz - 3.0);
+                yp1[k] = c31 * x[k] * (5.0 * zz - 1.0);
+                yp2[k] = 0.5 * c32 * z[k] * (xx - yy);
+                yp3[k] = c33 * x[k] * (xx - 3.0 * yy);
+            }
+            return true;
+        }
+        default:
+            return false;
+    }
+}
@@ -0,0 +1,18 @@
+#ifndef SPHERICAL_HARMONICS_HPP
+#define SPHERICAL_HARMONICS_HPP
+
+#include <cstddef>
+
+// Highest angular momentum supported by real_spherical_harmonics()
+constexpr int MAX_HARMONIC_L = 3;
+
+// Real spherical harmonics Y_lm(x, y, z) of the unit vectors (x[k], y[k],
+// z[k]) for m = -l..l, written to out[(m + l) * n + k]. Sign convention
+// and order as in the usual real basis: m < 0 ~ sin(|m| phi), m > 0 ~
+// cos(m phi), e.g. l = 1 gives (y, z, x) * sqrt(3/4pi). The loops are
+// plain arrays so the compiler can vectorize them. False if l is not
+// supported.
+bool real_spherical_harmonics(int l, size_t n, const double* x, const double* y, const double* z,
+                              double* out);
+
+#endif // SPHERICAL_HARMONICS_HPP
@@ -0,0 +1,377 @@
+#include "shard.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+
+namespace {
+
+std::string status_name(const Pipeline::FileResult& result) {
+    if (!result.done) {
+        return "skipped";
+    }
+    if (result.status == SUCCESS) {
+        return "ok";
+    }
+    return "error " + std::to_string(static_cast<int>(result.status));
+}
+
+std::vector<std::string> split_tabs(const std::string& line) {
+    std::vector<std::string> fields;
+    std::istringstream iss(line);
+    std::string field;
+    while (std::getline(iss, field, '\t')) {
+        fields.push_back(field);
+    }
+    return fields;
+}
+
+} // namespace
+
+bool ShardSpec::parse(const std::string& text, ShardSpec& shard) {
+    size_t slash = text.find('/');
+    if (slash == std::string::npos || slash == 0 || slash + 1 == text.size() ||
+        text.find_first_not_of("0123456789/") != std::string::npos) {
+        return false;
+    }
+
+    try {
+        shard.index = std::stoul(text.substr(0, slash));
+        shard.count = std::stoul(text.substr(slash + 1));
+    } catch (const std::exception&) {
+        return false;
+    }
+
+    return shard.count > 0 && shard.index < shard.count;
+}
+
+std::string ShardSpec::name() const {
+    char name[64];
+    std::snprintf(name, sizeof(name), "shard-%03zu-of-%03zu", index, count);
+    return name;
+}
+
+std::vector<std::string> ShardSpec::select(const std::vector<std::string>& files) const {
+    std::vector<std::string> selected;
+    for (size_t k = index; k < files.size(); k += count) {
+        selected.push_back(files[k]);
+    }
+    return selected;
+}
+
+bool read_manifest(const std::filesystem::path& manifest, std::vector<std::string>& files) {
+    std::ifstream file(manifest);
+    if (!file) {
+        std::cerr << "Error: Cannot read manifest '" << manifest.string() << "'\n";
+        return false;
+    }
+
+    std::filesystem::path base = manifest.parent_path();
+    std::string line;
+    while (std::getline(file, line)) {
+        // Trim whitespace (and the \r of CRLF files)
+        size_t first = line.find_first_not_of(" \t\r");
+        if (first == std::string::npos || line[first] == '#') {
+            continue;
+        }
+        size_t last = line.find_last_not_of(" \t\r");
+        std::filesystem::path path = line.substr(first, last - first + 1);
+
+        if (path.is_relative()) {
+            path = (base / path).lexically_normal();
+        }
+        files.push_back(path.string());
+    }
+
+    return true;
+}
+
+std::string run_id(const std::vector<std::string>& files) {
+    // FNV-1a over the paths, each terminated by a zero byte
+    uint64_t hash = 14695981039346656037ull;
+    for (const auto& file : files) {
+        for (unsigned char c : file) {
+            hash ^= c;
+            hash *= 1099511628211ull;
+        }
+        hash *= 1099511628211ull;
+    }
+    char id[32];
+    std::snprintf(id, sizeof(id), "%016llx-%zu", static_cast<unsigned long long>(hash), files.size());
+    return id;
+}
+
+bool write_shard_results(const std::filesystem::path& root, const ShardSpec& shard, const std::string& run,
+                         const std::vector<Pipeline::FileResult>& results, double wall_seconds) {
+    std::filesystem::path dir = root / SHARD_DIR;
+    std::error_code ec;
+    std::filesystem::create_directories(dir, ec);
+
+    // Write to a temporary name first, merge never sees half a file
+    std::filesystem::path path = dir / (shard.name() + ".tsv");
+    std::filesystem::path tmp = path;
+    tmp += ".tmp";
+    {
+        std::ofstream out(tmp);
+        if (!out) {
+            std::cerr << "Error: Cannot write '" << tmp.string() << "'\n";
+            return false;
+        }
+
+        out << "# shard " << shard.index << "/" << shard.count << "\n";
+        out << "# run " << run << "\n";
+        out << std::fixed << std::setprecision(6);
+        out << "# wall_seconds " << wall_seconds << "\n";
+        out << "# file\telement\tstatus\toutput_dir\tread_s\tparse_s\texport_s\n";
+        for (const auto& result : results) {
+            out << result.filename << "\t" << result.element << "\t" << status_name(result) << "\t"
+                << result.output_dir.string() << "\t" << result.read_seconds << "\t"
+                << result.parse_seconds << "\t" << result.export_seconds << "\n";
+        }
+        if (!out) {
+            std::cerr << "Error: Cannot write '" << tmp.string() << "'\n";
+            return false;
+        }
+    }
+
+    std::filesystem::rename(tmp, path, ec);
+    if (ec) {
+        std::cerr << "Error: Cannot write '" << path.string() << "': " << ec.message() << "\n";
+        return false;
+    }
+
+    return true;
+}
+
+ShardMerge::ShardMerge(const std::filesystem::path& root)
+    : root_(root) {
+}
+
+bool ShardMerge::run() {
+    count_ = 0;
+    run_.clear();
+    wall_seconds_.clear();
+    missing_.clear();
+    entries_.clear();
+
+    std::filesystem::path dir = root_ / SHARD_DIR;
+    std::error_code ec;
+    std::vector<std::filesystem::path> paths;
+    for (const auto& entry : std::filesystem::directory_iterator(dir, ec)) {
+        if (entry.is_regular_file() && entry.path().extension() == ".tsv") {
+            paths.push_back(entry.path());
+        }
+    }
+    if (ec || paths.empty()) {
+        std::cerr << "Error: No shard results found in '" << dir.string() << "'\n";
+        return false;
+    }
+    std::sort(paths.begin(), paths.end());
+
+    for (const auto& path : paths) {
+        if (!read_result_file(path)) {
+            return false;
+        }
+    }
+
+    for (size_t i = 0; i < count_; ++i) {
+        if (wall_seconds_.find(i) == wall_seconds_.end()) {
+            missing_.push_back(i);
+        }
+    }
+
+    return true;
+}
+
+bool ShardMerge::read_result_file(const std::filesystem::path& path) {
+    std::ifstream file(path);
+    if (!file) {
+        std::cerr << "Error: Cannot read '" << path.string() << "'\n";
+        return false;
+    }
+
+    ShardSpec shard;
+    bool have_shard = false;
+    std::string run;
+    double wall_seconds = 0.0;
+    std::vector<Entry> entries;
+
+    std::string line;
+    while (std::getline(file, line)) {
+        if (line.empty()) {
+            continue;
+        }
+        if (line[0] == '#') {
+            std::istringstream iss(line.substr(1));
+            std::string key;
+            std::string value;
+            iss >> key >> value;
+            if (key == "shard") {
+                have_shard = ShardSpec::parse(value, shard);
+            } else if (key == "run") {
+                run = value;
+            } else if (key == "wall_seconds") {
+                wall_seconds = std::atof(value.c_str());
+            }
+            continue;
+        }
+
+        std::vector<std::string> fields = split_tabs(line);
+        if (fields.size() != 7) {
+            std::cerr << "Error: Malformed line in '" << path.string() << "'\n";
+            return false;
+        }
+        Entry entry;
+        entry.file = fields[0];
+        entry.element = fields[1];
+        entry.status = fields[2];
+        entry.output_dir = fields[3];
+        entry.read_seconds = std::atof(fields[4].c_str());
+        entry.parse_seconds = std::atof(fields[5].c_str());
+        entry.export_seconds = std::atof(fields[6].c_str());
+        entries.push_back(std::move(entry));
+    }
+
+    if (!have_shard) {
+        std::cerr << "Error: '" << path.string() << "' is not a shard result file\n";
+        return false;
+    }
+    if (count_ != 0 && shard.count != count_) {
+        std::cerr << "Error: '" << path.string() << "' belongs to a run with " << shard.count
+                  << " shards, expected " << count_ << "\n";
+        return false;
+    }
+    if (run.empty()) {
+        std::cerr << "Error: '" << path.string() << "' has no run identity\n";
+        return false;
+    }
+    if (!run_.empty() && run != run_) {
+        std::cerr << "Error: '" << path.string() << "' belongs to another run (" << run << ", expected " << run_
+                  << "), remove stale result files\n";
+        return false;
+    }
+    count_ = shard.count;
+    run_ = run;
+    wall_seconds_[shard.index] = wall_seconds;
+
+    for (auto& entry : entries) {
+        entry.shard = shard.index;
+        entries_.push_back(std::move(entry));
+    }
+
+    return true;
+}
+
+bool ShardMerge::all_ok() const {
+    return std::all_of(entries_.begin(), entries_.end(), [](const Entry& entry) { return entry.status == "ok"; });
+}
+
+void ShardMerge::write_summary(std::ostream& out) const {
+    size_t ok = 0;
+    size_t skipped = 0;
+    std::vector<const Entry*> failed;
+    double read = 0.0;
+    double parse = 0.0;
+    double exported = 0.0;
+    for (const auto& entry : entries_) {
+        if (entry.status == "ok") {
+            ok++;
+        } else if (entry.status == "skipped") {
+            skipped++;
+        } else {
+            failed.push_back(&entry);
+        }
+        read += entry.read_seconds;
+        parse += entry.parse_seconds;
+        exported += entry.export_seconds;
+    }
+
+    out << "Shard summary: " << root_.string() << "\n\n";
+    out << "Shards: " << wall_seconds_.size() << " of " << count_ << " finished\n";
+    if (!missing_.empty()) {
+        out << "Missing shards:";
+        for (size_t i : missing_) {
+            out << " " << i;
+        }
+        out << "\n";
+    }
+    out << "Files: " << entries_.size() << " (" << ok << " ok, " << failed.size() << " failed, "
+        << skipped << " skipped)\n";
+
+    // Wall time of the slowest shard is the time of the whole run
+    out << std::fixed << std::setprecision(3);
+    double total = 0.0;
+    auto slowest = wall_seconds_.begin();
+    for (auto it = wall_seconds_.begin(); it != wall_seconds_.end(); ++it) {
+        total += it->second;
+        if (it->second > slowest->second) {
+            slowest = it;
+        }
+    }
+    if (slowest != wall_seconds_.end()) {
+        out << "Wall time: " << slowest->second << " s (slowest shard " << slowest->first
+            << "), " << total << " s summed over shards\n";
+    }
+    out << "Stage time: read " << read << " s, parse " << parse << " s, export " << exported << " s\n";
+
+    // Candidates for rebalancing the shards
+    std::vector<const Entry*> slowest_files;
+    for (const auto& entry : entries_) {
+        if (entry.status == "ok") {
+            slowest_files.push_back(&entry);
+        }
+    }
+    size_t n_slowest = std::min<size_t>(10, slowest_files.size());
+    std::partial_sort(slowest_files.begin(), slowest_files.begin() + n_slowest, slowest_files.end(),
+                      [](const Entry* a, const Entry* b) { return a->seconds() > b->seconds(); });
+    if (n_slowest > 0) {
+        out << "\nSlowest files:\n";
+        for (size_t i = 0; i < n_slowest; ++i) {
+            const Entry& entry = *slowest_files[i];
+            out << "  " << std::setw(9) << entry.seconds() << " s  " << std::left << std::setw(4)
+                << entry.element << std::right << " " << entry.file << "\n";
+        }
+    }
+
+    if (!failed.empty()) {
+        out << "\nFailed files:\n";
+        for (const Entry* entry : failed) {
+            out << "  " << entry->file << " (" << entry->status << ", shard " << entry->shard << ")\n";
+        }
+    }
+}
+
+void ShardMerge::write_index(std::ostream& out) const {
+    std::vector<const Entry*> entries;
+    for (const auto& entry : entries_) {
+        if (entry.status == "ok") {
+            entries.push_back(&entry);
+        }
+    }
+    std::sort(entries.begin(), entries.end(), [](const Entry* a, const Entry* b) {
+        return a->element != b->element ? a->element < b->element : a->file < b->file;
+    });
+
+    out << "# element\tfile\toutput_dir\tshard\n";
+    for (const Entry* entry : entries) {
+        out << entry->element << "\t" << entry->file << "\t" << entry->output_dir << "\t"
+            << entry->shard << "\n";
+    }
+}
+
+bool ShardMerge::write_files() const {
+    std::ofstream summary(root_ / SUMMARY_FILE);
+    std::ofstream index(root_ / INDEX_FILE);
+    if (!summary || !index) {
+        std::cerr << "Error: Cannot write merge results to '" << root_.string() << "'\n";
+        return false;
+    }
+
+    write_summary(summary);
+    write_index(index);
+    return static_cast<bool>(summary) && static_cast<bool>(index);
+}
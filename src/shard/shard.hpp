@@ -0,0 +1,100 @@
+#ifndef SHARD_HPP
+#define SHARD_HPP
+
+#include <filesystem>
+#include <map>
+#include <ostream>
+#include <string>
+#include <vector>
+#include "../pipeline/pipeline.hpp"
+
+// Splitting a large run over independent processes: every process gets the
+// same input list (arguments and/or a manifest) plus `--shard i/N`, handles
+// its own deterministic subset and writes a result file to <root>/shards/.
+// `merge` combines the result files into one summary and index. No process
+// needs to know about the others, so shards can be local processes or the
+// tasks of a cluster job array.
+
+// Subdirectory of the output root holding the per-shard result files
+constexpr const char* SHARD_DIR = "shards";
+
+struct ShardSpec {
+    size_t index = 0;  // 0 <= index < count
+    size_t count = 1;
+
+    // Parse "i/N"
+    static bool parse(const std::string& text, ShardSpec& shard);
+
+    // File name stem, e.g. "shard-003-of-016"
+    std::string name() const;
+
+    // Input k belongs to shard k mod N, neighbouring inputs (often similar
+    // in size) end up in different shards
+    std::vector<std::string> select(const std::vector<std::string>& files) const;
+};
+
+// Read a manifest: one UPF path per line, blank lines and lines starting
+// with '#' are skipped, relative paths are relative to the manifest
+bool read_manifest(const std::filesystem::path& manifest, std::vector<std::string>& files);
+
+// Identity of a run, a hash of the full ordered input list before the
+// shard selection. Every shard of a run computes the same value, result
+// files of another run (stale files, a changed list) do not match.
+std::string run_id(const std::vector<std::string>& files);
+
+// Write the results and timings of one shard to <root>/shards/<name>.tsv
+bool write_shard_results(const std::filesystem::path& root, const ShardSpec& shard, const std::string& run,
+                         const std::vector<Pipeline::FileResult>& results, double wall_seconds);
+
+// Combines the result files of all shards below an output root
+class ShardMerge {
+public:
+    explicit ShardMerge(const std::filesystem::path& root);
+
+    // Read all result files, false if there are none or they come from
+    // different runs (input list or N)
+    bool run();
+
+    // True if every shard of the run has written its result file
+    bool complete() const { return missing_.empty(); }
+
+    // True if every file of the finished shards was processed successfully
+    bool all_ok() const;
+
+    // Shard and file counts, timings, slowest and failed files
+    void write_summary(std::ostream& out) const;
+
+    // Successful files sorted by element: element, file, output directory, shard
+    void write_index(std::ostream& out) const;
+
+    // Write summary.txt and index.tsv to the output root
+    bool write_files() const;
+
+    static constexpr const char* SUMMARY_FILE = "summary.txt";
+    static constexpr const char* INDEX_FILE = "index.tsv";
+
+private:
+    struct Entry {
+        std::string file;
+        std::string element;
+        std::string status;  // "ok", "skipped" or "error <code>"
+        std::string output_dir;
+        double read_seconds = 0.0;
+        double parse_seconds = 0.0;
+        double export_seconds = 0.0;
+        size_t shard = 0;
+
+        double seconds() const { return read_seconds + parse_seconds + export_seconds; }
+    };
+
+    std::filesystem::path root_;
+    size_t count_ = 0;
+    std::string run_;
+    std::map<size_t, double> wall_seconds_;  // shard index -> wall time
+    std::vector<size_t> missing_;
+    std::vector<Entry> entries_;
+
+    bool read_result_file(const std::filesystem::path& path);
+};
+
+#endif // SHARD_HPP